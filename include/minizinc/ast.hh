@@ -249,6 +249,8 @@ namespace MiniZinc {
     
     /// Mark \a e as alive for garbage collection
     static void mark(Expression* e);
+    /// Mark the components of \a e that are not expressions, and push its sub-expressions onto \a stack
+    static void markChildren(const Expression* e, std::vector<const Expression*>& stack);
   };
 
   /// \brief Integer literal expression
@@ -745,6 +747,8 @@ namespace MiniZinc {
     WeakRef _flat;
     /// Integer payload
     int _payload;
+    /// Record of the variable in the occurrence index of the flat model
+    int _occIdx;
   public:
     /// The identifier of this expression type
     static const ExpressionId eid = E_VARDECL;
@@ -795,6 +799,10 @@ namespace MiniZinc {
     int payload(void) const { return _payload; }
     /// Set payload
     void payload(int i) { _payload = i; }
+    /// Access record in the occurrence index of the flat model
+    int occIdx(void) const { return _occIdx; }
+    /// Set record in the occurrence index of the flat model
+    void occIdx(int i) { _occIdx = i; }
   };
   
   class EnvI;
@@ -1173,7 +1181,7 @@ namespace MiniZinc {
 
     /// Mark for GC
     void mark(void) {
-      _gc_mark = 1;
+      gcMark();
       loc().mark();
     }
   };
@@ -1372,10 +1380,6 @@ namespace MiniZinc {
         ASTString doc_comment;
         ASTString is_introduced;
       } ann;
-      /// Keep track of allocated integer literals
-      UNORDERED_NAMESPACE::unordered_map<IntVal, WeakRef> integerMap;
-      /// Keep track of allocated float literals
-      UNORDERED_NAMESPACE::unordered_map<FloatVal, WeakRef> floatMap;
       /// Constructor
       Constants(void);
       /// Return shared BoolLit
@@ -38,36 +38,12 @@ namespace MiniZinc {
     rehash();
   }
 
-  inline IntLit*
-  IntLit::a(MiniZinc::IntVal v) {
-    UNORDERED_NAMESPACE::unordered_map<IntVal, WeakRef>::iterator it = constants().integerMap.find(v);
-    if (it==constants().integerMap.end() || it->second()==NULL) {
-      IntLit* il = new IntLit(Location().introduce(), v);
-      constants().integerMap.insert(std::make_pair(v, il));
-      return il;
-    } else {
-      return it->second()->cast<IntLit>();
-    }
-  }
-  
   inline
   FloatLit::FloatLit(const Location& loc, FloatVal v)
   : Expression(loc,E_FLOATLIT,Type::parfloat()), _v(v) {
     rehash();
   }
 
-  inline FloatLit*
-  FloatLit::a(MiniZinc::FloatVal v) {
-    UNORDERED_NAMESPACE::unordered_map<FloatVal, WeakRef>::iterator it = constants().floatMap.find(v);
-    if (it==constants().floatMap.end() || it->second()==NULL) {
-      FloatLit* fl = new FloatLit(Location().introduce(), v);
-      constants().floatMap.insert(std::make_pair(v, fl));
-      return fl;
-    } else {
-      return it->second()->cast<FloatLit>();
-    }
-  }
-
   inline
   SetLit::SetLit(const Location& loc,
                  const std::vector<Expression*>& v)
@@ -364,6 +340,7 @@ namespace MiniZinc {
     _e = e;
     _id->type(type());
     _payload = 0;
+    _occIdx = -1;
     rehash();
   }
 
@@ -379,6 +356,7 @@ namespace MiniZinc {
     _e = e;
     _id->type(type());
     _payload = 0;
+    _occIdx = -1;
     rehash();
   }
 
@@ -394,6 +372,7 @@ namespace MiniZinc {
     _e = e;
     _id->type(type());
     _payload = 0;
+    _occIdx = -1;
     rehash();
   }
 
@@ -412,6 +391,7 @@ namespace MiniZinc {
     _e = e;
     _id->type(type());
     _payload = 0;
+    _occIdx = -1;
     rehash();
   }
 
@@ -114,13 +114,17 @@ namespace MiniZinc {
 
   /**
    * \brief Garbage collected string
+   *
+   * Strings are interned, so that there is at most one string object
+   * with a given contents.
    */
   class ASTStringO : public ASTChunk {
+    friend class GC;
   protected:
     /// Constructor
-    ASTStringO(const std::string& s);
+    ASTStringO(const std::string& s, size_t h);
   public:
-    /// Allocate and initialise as \a s
+    /// Return interned string equal to \a s, allocating it if necessary
     static ASTStringO* a(const std::string& s);
     /// Return underlying C-style string
     const char* c_str(void) const { return _data+sizeof(size_t); }
@@ -138,7 +142,7 @@ namespace MiniZinc {
     }
     /// Mark for garbage collection
     void mark(void) const {
-      _gc_mark = 1;
+      gcMark();
     }
   };
 
@@ -164,8 +168,8 @@ namespace MiniZinc {
 
   inline bool
   ASTString::operator== (const ASTString& s) const {
-    return size()==s.size() &&
-      (size()==0 || strncmp(_s->c_str(),s._s->c_str(),size())==0);
+    // Equal non-empty strings share the same object
+    return _s==s._s || (_s==NULL && s._s->size()==0) || (s._s==NULL && _s->size()==0);
   }
   inline bool
   ASTString::operator!= (const ASTString& s) const {
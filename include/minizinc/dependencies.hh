@@ -0,0 +1,81 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_DEPENDENCIES_HH__
+#define __MINIZINC_DEPENDENCIES_HH__
+
+#include <minizinc/model.hh>
+
+#include <string>
+#include <vector>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Dependencies of a flat model on its sources and data
+   *
+   * Records a hash of the source files and the flattening options, and a
+   * hash of the value of each top-level declaration of a typechecked
+   * model. The output of a previous compilation can be reused as a whole
+   * if none of the hashes changed. Parts of it cannot be reused on their
+   * own: flattening tightens variable domains and shares common
+   * subexpressions across items, introduced variables are numbered
+   * globally, and the optimiser rewrites the whole flat model.
+   *
+   * The hashes of the output files are recorded as well, so that output
+   * files that were edited or written by another compilation are not
+   * reused.
+   */
+  class Dependencies {
+  public:
+    /// A top-level declaration
+    struct Decl {
+      /// Name of the declared identifier
+      std::string name;
+      /// Hash of the value (zero if there is none)
+      unsigned long long int hash;
+    };
+    /// An output file
+    struct Output {
+      /// Name of the file
+      std::string name;
+      /// Hash of the contents
+      unsigned long long int hash;
+    };
+  protected:
+    /// Hash of the source files and the options
+    unsigned long long int _sources;
+    /// The top-level declarations
+    std::vector<Decl> _decls;
+    /// The output files
+    std::vector<Output> _outputs;
+  public:
+    /// Constructor
+    Dependencies(void);
+    /// Compute the dependencies of typechecked model \a m, flattened with \a options
+    void compute(Model* m, const std::string& options);
+    /// Record the hashes of the output files \a files
+    void outputs(const std::vector<std::string>& files);
+    /// Return whether the output files are still the ones that were recorded
+    bool outputsUnchanged(void) const;
+    /// Read dependencies from \a filename, return false if that failed
+    bool read(const std::string& filename);
+    /// Write dependencies to \a filename, return false if that failed
+    bool write(const std::string& filename) const;
+    /// Return whether sources, options and all declarations are the same as in \a d
+    bool unchanged(const Dependencies& d) const;
+    /// Return the names of the declarations that were added, removed or changed since \a d
+    std::vector<std::string> changed(const Dependencies& d) const;
+  };
+
+}
+
+#endif
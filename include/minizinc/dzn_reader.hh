@@ -0,0 +1,78 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_DZN_READER_HH__
+#define __MINIZINC_DZN_READER_HH__
+
+#include <string>
+
+#include <minizinc/ast.hh>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Reader for assignments of literal values in dzn syntax
+   *
+   * Reads assignments of the form <tt>x = e;</tt> where \a e is a Boolean,
+   * integer or float literal, an integer range or set literal, or a
+   * one-dimensional array of such literals, optionally wrapped in an
+   * \c arrayNd call with literal index ranges. The values are constructed
+   * directly, without going through the lexer and parser. Any other input
+   * is reported as unsupported, so that callers can fall back to the full
+   * parser, which also produces the error messages.
+   */
+  class DznReader {
+  protected:
+    /// Current position
+    const char* _p;
+    /// End of input
+    const char* _end;
+    /// File name used for locations
+    std::string _filename;
+    /// Location used for constructed expressions
+    Location _loc;
+    /// Current line
+    unsigned int _line;
+    /// Skip white space and comments
+    void skip(void);
+    /// Consume character \a c (after white space) if it is next
+    bool accept(char c);
+    /// Consume keyword \a kw if it is next and not followed by an identifier character
+    bool acceptKeyword(const char* kw);
+    /// Read an integer
+    bool readInt(IntVal& v);
+    /// Read a number, \a isInt returns whether it was an integer
+    bool readNumber(IntVal& iv, FloatVal& fv, bool& isInt);
+    /// Read an index range l..u
+    bool readRange(int& l, int& u);
+    /// Read a scalar or set literal
+    Expression* readScalar(bool asFloat);
+  public:
+    /// Construct reader for text in [\a begin, \a end)
+    DznReader(const char* begin, const char* end, const std::string& filename="");
+    /// Skip white space and comments, return whether the input is exhausted
+    bool done(void);
+    /// Read identifier and equals sign of the next assignment
+    bool readAssignmentId(std::string& id);
+    /// Read a literal, reading integers as floats if \a asFloat is true
+    /// Returns NULL if the right hand side is not supported.
+    Expression* readLiteral(bool asFloat=false);
+    /// Read the semicolon terminating an assignment (optional at the end of the input)
+    bool readAssignmentEnd(void);
+    /// Return current position
+    const char* pos(void) const { return _p; }
+    /// Return current line
+    unsigned int line(void) const { return _line; }
+  };
+
+}
+
+#endif
@@ -136,7 +136,6 @@ namespace MiniZinc {
     ArrayLit* al = in()->cast<ArrayLit>();
     CallStackItem csi(env, e->decl(gen,id)->id(), i);
     e->decl(gen,id)->e(al->v()[i.toInt()]);
-    e->rehash();
     if (id == e->n_decls(gen)-1) {
       if (gen == e->n_generators()-1) {
         bool where = true;
@@ -13,6 +13,7 @@
 #define __MINIZINC_FILE_UTILS_HH__
 
 #include <string>
+#include <cstddef>
 
 namespace MiniZinc { namespace FileUtils {
 
@@ -24,6 +25,65 @@ namespace MiniZinc { namespace FileUtils {
   bool directory_exists(const std::string& dirname);
   /// Return full path to file
   std::string file_path(const std::string& filename);
+
+  /**
+   * \brief Contents of a source file
+   *
+   * The contents are memory-mapped twice: a read-only view, and a private
+   * (copy-on-write) scan buffer that is followed by two NUL bytes, so
+   * that the lexer can scan it in place. The lexer writes into the scan
+   * buffer, so the read-only view should be used for everything else.
+   * On Windows, for empty files, and for text that is not read from a
+   * file, a single copy in memory serves as both.
+   *
+   * Memory of mapped contents that have been processed can be released
+   * while reading, so that large files are not resident as a whole.
+   */
+  class SourceFile {
+  protected:
+    /// The read-only view
+    const char* _data;
+    /// The scan buffer
+    char* _scan;
+    /// Size of the contents
+    size_t _size;
+    /// Whether the contents are memory-mapped
+    bool _mapped;
+    /// Copy of the contents, followed by two NUL bytes (if not mapped)
+    std::string _text;
+    /// Whether a file was opened or text assigned
+    bool _open;
+    /// Number of bytes at the beginning whose memory has been released
+    size_t _released;
+    /// Release the contents
+    void close(void);
+  private:
+    SourceFile(const SourceFile&);
+    SourceFile& operator =(const SourceFile&);
+  public:
+    /// Constructor
+    SourceFile(void);
+    /// Destructor
+    ~SourceFile(void);
+    /// Open file \a filename, return false if that failed
+    bool open(const std::string& filename);
+    /// Use a copy of \a text as the contents
+    void assign(const std::string& text);
+    /// Return whether a file was opened or text assigned
+    bool isOpen(void) const { return _open; }
+    /// Return the contents
+    const char* data(void) const { return _data; }
+    /// Return the size of the contents
+    size_t size(void) const { return _size; }
+    /// Return the scan buffer
+    char* scanBuffer(void) { return _scan; }
+    /// Return the size of the scan buffer (including the two NUL bytes)
+    size_t scanSize(void) const { return _size+2; }
+    /// Release the memory of the first \a n bytes of both views, which are no
+    /// longer needed (they can still be read, but the scan buffer then
+    /// contains the original file contents)
+    void release(size_t n);
+  };
 }}
 
 #endif
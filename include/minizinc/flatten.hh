@@ -15,6 +15,9 @@
 #include <minizinc/model.hh>
 #include <minizinc/astexception.hh>
 
+#include <map>
+#include <string>
+
 namespace MiniZinc {
 
   /// Exception thrown for errors during flattening
@@ -27,12 +30,16 @@ namespace MiniZinc {
     }
   };
 
+  class Profiler;
+
   /// Options for the flattener
   struct FlatteningOptions {
     /// Keep output in resulting flat model
     bool keepOutputInFzn;
+    /// Profiler that records the cost of flattening, or NULL
+    Profiler* profiler;
     /// Default constructor
-    FlatteningOptions(void) : keepOutputInFzn(false) {}
+    FlatteningOptions(void) : keepOutputInFzn(false), profiler(NULL) {}
   };
   
   /// Flatten model \a m
@@ -59,6 +66,8 @@ namespace MiniZinc {
     int n_float_ct;
     /// Number of set constraints
     int n_set_ct;
+    /// Number of constraints per predicate name
+    std::map<std::string,int> n_pred_ct;
     /// Constructor
     FlatModelStatistics(void)
     : n_int_vars(0), n_bool_vars(0), n_float_vars(0), n_set_vars(0),
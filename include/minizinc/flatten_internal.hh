@@ -74,7 +74,7 @@ namespace MiniZinc {
       WeakRef b;
       WW(WeakRef r0, WeakRef b0) : r(r0), b(b0) {}
     };
-    typedef KeepAliveMap<WW> Map;
+    typedef CSEMap<WW> Map;
     bool ignorePartial;
     std::vector<Expression*> callStack;
     std::vector<KeepAlive> errorStack;
@@ -84,8 +84,11 @@ namespace MiniZinc {
     bool collect_vardecls;
     std::vector<int> modifiedVarDecls;
     int in_redundant_constraint;
+    Profiler* profiler;
   protected:
     Map map;
+    /// Number of successful CSE lookups
+    unsigned long long int map_hits;
     Model* _flat;
     unsigned int ids;
     ASTStringMap<ASTString>::t reifyMap;
@@ -97,6 +100,8 @@ namespace MiniZinc {
     Map::iterator map_find(Expression* e);
     void map_remove(Expression* e);
     Map::iterator map_end(void);
+    unsigned long long int map_lookups(void) const;
+    unsigned long long int map_hitcount(void) const;
     void dump(void);
     
     void flat_addItem(Item* i);
@@ -117,18 +122,49 @@ namespace MiniZinc {
 
   EE flat_exp(EnvI& env, Ctx ctx, Expression* e, VarDecl* r, VarDecl* b);
 
-  class CmpExpIdx {
+  /**
+   * \brief Table mapping the terms of a linear expression to their first position
+   *
+   * Identifiers are keyed by identity (callers resolve them to the
+   * identifier of their declaration first), all other expressions are
+   * compared structurally.
+   */
+  class LinTermTable {
+  protected:
+    /// Open addressing table of terms and positions (NULL if empty)
+    std::vector<std::pair<Expression*,int> > _t;
+    /// Return hash value of \a e
+    static size_t hash(Expression* e) {
+      if (!e->isa<Id>())
+        return Expression::hash(e);
+      size_t h = reinterpret_cast<size_t>(e) >> 3;
+      h *= 2654435761U;
+      return h ^ (h >> 15);
+    }
+    /// Test whether \a e0 and \a e1 are the same term
+    static bool equal(Expression* e0, Expression* e1) {
+      return e0==e1 || (!e0->isa<Id>() && !e1->isa<Id>() && Expression::equal(e0,e1));
+    }
   public:
-    std::vector<KeepAlive>& x;
-    CmpExpIdx(std::vector<KeepAlive>& x0) : x(x0) {}
-    bool operator ()(int i, int j) const {
-      if (Expression::equal(x[i](),x[j]()))
-        return false;
-      if (x[i]()->isa<Id>() && x[j]()->isa<Id>() &&
-          x[i]()->cast<Id>()->idn() != -1 &&
-          x[j]()->cast<Id>()->idn() != -1)
-        return x[i]()->cast<Id>()->idn() < x[j]()->cast<Id>()->idn();
-      return x[i]()<x[j]();
+    /// Constructor for at most \a n terms
+    LinTermTable(size_t n) {
+      size_t cap = 4;
+      while (cap < 2*n)
+        cap *= 2;
+      _t.resize(cap, std::pair<Expression*,int>(static_cast<Expression*>(NULL),-1));
+    }
+    /// Return first position of term \a e, or insert \a e at position \a i and return \a i
+    int insert(Expression* e, int i) {
+      size_t mask = _t.size()-1;
+      for (size_t h = hash(e) & mask; ; h = (h+1) & mask) {
+        if (_t[h].first==NULL) {
+          _t[h].first = e;
+          _t[h].second = i;
+          return i;
+        }
+        if (equal(_t[h].first,e))
+          return _t[h].second;
+      }
     }
   };
   
@@ -194,43 +230,24 @@ namespace MiniZinc {
     }
     static bool domain_empty(Domain dom) { return dom->size()==0; }
     static Domain limit_domain(BinOpType bot, Domain dom, Val v) {
-      IntSetRanges dr(dom);
-      IntSetVal* ndomain;
       switch (bot) {
         case BOT_LE:
           v -= 1;
           // fall through
         case BOT_LQ:
-        {
-          Ranges::Bounded<IntSetRanges> b = Ranges::Bounded<IntSetRanges>::maxiter(dr,v);
-          ndomain = IntSetVal::ai(b);
-        }
-          break;
+          return IntSetVal::intersect(dom, -IntVal::infinity(), v);
         case BOT_GR:
           v += 1;
           // fall through
         case BOT_GQ:
-        {
-          Ranges::Bounded<IntSetRanges> b = Ranges::Bounded<IntSetRanges>::miniter(dr,v);
-          ndomain = IntSetVal::ai(b);
-        }
-          break;
+          return IntSetVal::intersect(dom, v, IntVal::infinity());
         case BOT_NQ:
-        {
-          Ranges::Const c(v,v);
-          Ranges::Diff<IntSetRanges,Ranges::Const> d(dr,c);
-          ndomain = IntSetVal::ai(d);
-        }
-          break;
+          return IntSetVal::remove(dom, v);
         default: assert(false); return NULL;
       }
-      return ndomain;
     }
     static Domain intersect_domain(Domain dom, Val v0, Val v1) {
-      IntSetRanges dr(dom);
-      Ranges::Const c(v0,v1);
-      Ranges::Inter<IntSetRanges,Ranges::Const> inter(dr,c);
-      return IntSetVal::ai(inter);
+      return IntSetVal::intersect(dom, v0, v1);
     }
     static Val floor_div(Val v0, Val v1) {
       return static_cast<long long int>(floor(static_cast<FloatVal>(v0.toInt()) / static_cast<FloatVal>(v1.toInt())));
@@ -380,9 +397,7 @@ namespace MiniZinc {
   void simplify_lin(std::vector<typename LinearTraits<Lit>::Val>& c,
                     std::vector<KeepAlive>& x,
                     typename LinearTraits<Lit>::Val& d) {
-    std::vector<int> idx(c.size());
-    for (unsigned int i=idx.size(); i--;) {
-      idx[i]=i;
+    for (unsigned int i=x.size(); i--;) {
       Expression* e = follow_id_to_decl(x[i]());
       if (VarDecl* vd = e->dyn_cast<VarDecl>()) {
         if (vd->e() && vd->e()->isa<Lit>()) {
@@ -394,28 +409,21 @@ namespace MiniZinc {
         x[i] = e;
       }
     }
-    std::sort(idx.begin(),idx.end(),CmpExpIdx(x));
-    unsigned int ci = 0;
-    for (; ci<x.size(); ci++) {
-      if (Lit* il = x[idx[ci]]()->dyn_cast<Lit>()) {
-        d += c[idx[ci]]*il->v();
-        c[idx[ci]] = 0;
+    // Merge each term into its first occurrence, in linear time
+    LinTermTable terms(x.size());
+    for (unsigned int i=0; i<x.size(); i++) {
+      if (Lit* il = x[i]()->dyn_cast<Lit>()) {
+        d += c[i]*il->v();
+        c[i] = 0;
       } else {
-        break;
-      }
-    }
-    for (unsigned int i=ci+1; i<x.size(); i++) {
-      if (Expression::equal(x[idx[i]](),x[idx[ci]]())) {
-        c[idx[ci]] += c[idx[i]];
-        c[idx[i]] = 0;
-      } else if (Lit* il = x[idx[i]]()->dyn_cast<Lit>()) {
-        d += c[idx[i]]*il->v();
-        c[idx[i]] = 0;
-      } else {
-        ci=i;
+        int first = terms.insert(x[i](), i);
+        if (first != static_cast<int>(i)) {
+          c[first] += c[i];
+          c[i] = 0;
+        }
       }
     }
-    ci = 0;
+    unsigned int ci = 0;
     for (unsigned int i=0; i<c.size(); i++) {
       if (c[i] != 0) {
         c[ci] = c[i];
@@ -15,6 +15,7 @@
 #include <cstdlib>
 #include <cassert>
 #include <new>
+#include <vector>
 
 namespace MiniZinc {
   
@@ -24,8 +25,9 @@ namespace MiniZinc {
   class ASTNode {
     friend class GC;
   protected:
-    /// Mark for garbage collection
-    mutable unsigned int _gc_mark : 1;
+    /// Mark for garbage collection (a separate byte, so that marking
+    /// threads can set it atomically while others read the bit-fields)
+    mutable unsigned char _gc_mark;
     /// Id of the node
     unsigned int _id : 7;
     /// Secondary id
@@ -40,6 +42,18 @@ namespace MiniZinc {
     /// Constructor
     ASTNode(unsigned int id) : _gc_mark(0), _id(id) {}
 
+    /// Whether several threads are currently marking
+    static bool _parallelMark;
+    /// Set mark of \a n atomically, return whether it was not set before
+    static bool atomicMark(const ASTNode* n);
+    /// Mark for garbage collection (atomically while several threads are marking)
+    void gcMark(void) const {
+      if (_parallelMark)
+        atomicMark(this);
+      else
+        _gc_mark = 1;
+    }
+
   public:
     /// Allocate node
     void* operator new(size_t size);
@@ -103,6 +117,54 @@ namespace MiniZinc {
     static void* alloc(size_t size);
   };
 
+  /**
+   * \brief Hash table of interned nodes
+   *
+   * The table uses open addressing with linear probing. It does not
+   * keep its nodes alive: the garbage collector removes unreachable
+   * nodes from all interning tables before their memory is swept.
+   */
+  class InternTable {
+    friend class GC;
+  protected:
+    /// Table entry
+    struct Entry {
+      /// The node, or NULL if the entry is free
+      ASTNode* n;
+      /// Hash value of the node
+      size_t h;
+      /// Constructor
+      Entry(void) : n(NULL), h(0) {}
+    };
+    /// Entries (the number of entries is zero or a power of two)
+    std::vector<Entry> _e;
+    /// Number of nodes in the table
+    size_t _n;
+    /// Insert node \a n with hash \a h, the table must have a free entry
+    void insert(ASTNode* n, size_t h);
+  public:
+    /// Constructor
+    InternTable(void) : _n(0) {}
+    /// Return node with hash \a h for which \a eq returns true, or NULL
+    template<class T, class Eq>
+    T* find(size_t h, const Eq& eq) const {
+      if (_e.empty())
+        return NULL;
+      size_t mask = _e.size()-1;
+      for (size_t i = h & mask; _e[i].n != NULL; i = (i+1) & mask) {
+        if (_e[i].h==h && eq(static_cast<T*>(_e[i].n)))
+          return static_cast<T*>(_e[i].n);
+      }
+      return NULL;
+    }
+    /// Add node \a n with hash \a h
+    void add(ASTNode* n, size_t h);
+    /// Return number of nodes in the table
+    size_t size(void) const { return _n; }
+    /// Return memory used by the table entries (in bytes)
+    size_t memsize(void) const { return _e.size()*sizeof(Entry); }
+  };
+
   class Model;
   class Expression;
 
@@ -153,8 +215,59 @@ namespace MiniZinc {
     /// Untrail to previous mark
     static void untrail(void);
     
+    /// Run a full collection now and return cached pages to the system
+    static void collect(void);
+
     /// Return maximum allocated memory (high water mark)
     static size_t maxMem(void);
+    /// Return memory currently occupied by objects (live or not yet swept)
+    static size_t usedMem(void);
+
+    /// Collector modes
+    enum Mode {
+      /// Mark and sweep the entire heap in a single pause
+      GCM_FULL,
+      /// Mark the entire heap, then sweep pages lazily during allocation
+      GCM_INCREMENTAL
+    };
+    /// Set collector mode for this thread
+    static void mode(Mode m);
+    /// Return collector mode for this thread
+    static Mode mode(void);
+    /// Set number of threads that mark the heap of this thread (ignored without thread support)
+    static void markThreads(unsigned int n);
+    /// Return number of threads that mark the heap of this thread
+    static unsigned int markThreads(void);
+    /// Return time spent in the mark phase of each collection (in milliseconds)
+    static const std::vector<double>& markTimes(void);
+    /// Return total number of bytes allocated
+    static unsigned long long int allocated(void);
+    /// Return number of garbage collections
+    static unsigned int collections(void);
+    /// Return total time spent in collector pauses (in milliseconds)
+    static double pauseTime(void);
+    /// Return longest collector pause (in milliseconds)
+    static double maxPauseTime(void);
+    /// Return table of interned strings
+    static InternTable& strings(void);
+    /// Return table of interned integer literals
+    static InternTable& intLits(void);
+    /// Return table of interned float literals
+    static InternTable& floatLits(void);
+    /// Return table of interned integer set values
+    static InternTable& intSets(void);
+    /// Return number of interned strings
+    static size_t internedStrings(void);
+    /// Return memory used by interned strings and their table (in bytes)
+    static size_t internedStringMem(void);
+    /// Return number of heap pages for small and medium sized objects
+    static unsigned int pages(void);
+    /// Return number of pages holding a large object
+    static unsigned int largePages(void);
+    /// Return number of pages kept for reuse by large objects
+    static unsigned int cachedLargePages(void);
+    /// Return fraction of the pages for small and medium sized objects on free lists
+    static double fragmentation(void);
   };
 
   /// Automatic garbage collection lock
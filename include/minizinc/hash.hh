@@ -154,6 +154,61 @@ namespace MiniZinc {
     }
   };
   
+  /// Hash map from expressions to \a T for common subexpression elimination
+  /**
+   * Keys are plain expression pointers, hashed using the hash value
+   * cached in each expression. Every entry keeps its key alive, so a key
+   * is added to the garbage collector's root set once on insertion,
+   * rather than once per lookup as with KeepAliveMap.
+   */
+  template<class T>
+  class CSEMap {
+  public:
+    /// Map entry that keeps its key alive
+    class Entry : public T {
+    protected:
+      /// Root for the key of this entry
+      KeepAlive _key;
+    public:
+      /// Constructor
+      Entry(Expression* e, const T& t) : T(t), _key(e) {}
+    };
+  protected:
+    /// The underlying map implementation
+    UNORDERED_NAMESPACE::unordered_map<Expression*,Entry,ExpressionHash,ExpressionEq> _m;
+    /// Number of lookups (find or remove) performed
+    unsigned long long int _lookups;
+  public:
+    /// Iterator type
+    typedef typename UNORDERED_NAMESPACE::unordered_map<Expression*,Entry,
+      ExpressionHash,ExpressionEq>::iterator iterator;
+    /// Constructor
+    CSEMap(void) : _lookups(0) {}
+    /// Insert mapping from \a e to \a t
+    void insert(Expression* e, const T& t) {
+      assert(e != NULL);
+      _m.insert(std::pair<Expression*,Entry>(e,Entry(e,t)));
+    }
+    /// Find \a e in map
+    iterator find(Expression* e) { _lookups++; return _m.find(e); }
+    /// Begin of iterator
+    iterator begin(void) { return _m.begin(); }
+    /// End of iterator
+    iterator end(void) { return _m.end(); }
+    /// Remove binding of \a e from map
+    void remove(Expression* e) {
+      _lookups++;
+      _m.erase(e);
+    }
+    /// Return number of lookups that did not have to root their key
+    unsigned long long int lookups(void) const { return _lookups; }
+    template <class D> void dump(void) {
+      for (iterator i = _m.begin(); i != _m.end(); ++i) {
+        std::cerr << i->first << ": " << D::d(i->second) << std::endl;
+      }
+    }
+  };
+
   class ExpressionSetIter : public UNORDERED_NAMESPACE::unordered_set<Expression*,ExpressionHash,ExpressionEq>::iterator {
   protected:
     bool _empty;
@@ -42,6 +42,28 @@ namespace MiniZinc {
     /// Map from identifiers to function declarations
     FnMap fnmap;
 
+    /// Key for overload resolution: list of candidates, and argument types
+    typedef std::pair<const std::vector<FunctionI*>*,std::vector<int> > FnCacheKey;
+    /// Hash function for overload resolution keys
+    struct FnCacheHash {
+      size_t operator()(const FnCacheKey& k) const;
+    };
+    /// Type of overload resolution cache
+    typedef UNORDERED_NAMESPACE::unordered_map<FnCacheKey,FunctionI*,FnCacheHash> FnCache;
+    /// Cache of overload resolution results
+    mutable FnCache _fnCache;
+    /// Key used for cache lookups (kept to avoid allocation)
+    mutable FnCacheKey _fnCacheKey;
+    /// Whether the cache can be used (functions have been sorted)
+    bool _fnCacheEnabled;
+    /// Number of overload resolutions answered from the cache
+    mutable unsigned long long int _fnCacheHits;
+    /// Number of overload resolutions not answered from the cache
+    mutable unsigned long long int _fnCacheMisses;
+    /// Set up \a _fnCacheKey for candidates \a v and arguments \a args
+    template<class Args>
+    void fnCacheKey(const std::vector<FunctionI*>* v, int kind, const Args& args) const;
+
     /// Filename of the model
     ASTString _filename;
     /// Path of the model
@@ -106,6 +128,10 @@ namespace MiniZinc {
     FunctionI* matchFn(EnvI& env, const ASTString& id, const std::vector<Type>& t);
     /// Return function declaration matching call \a c
     FunctionI* matchFn(EnvI& env, Call* c) const;
+    /// Return number of overload resolutions answered from the cache
+    unsigned long long int fnCacheHits(void) const;
+    /// Return number of overload resolutions not answered from the cache
+    unsigned long long int fnCacheMisses(void) const;
 
     /// Return item \a i
     Item*& operator[] (int i);
@@ -249,6 +275,10 @@ namespace MiniZinc {
     void clearWarnings(void);
     
     unsigned int maxCallStack(void) const;
+    /// Return number of CSE lookups performed without rooting the key
+    unsigned long long int cseLookups(void) const;
+    /// Return number of CSE lookups that found a reusable result
+    unsigned long long int cseHits(void) const;
   };
 
   class CallStackItem {
@@ -18,11 +18,113 @@
 
 namespace MiniZinc {
 
+  /**
+   * \brief Index of variable declarations and their occurrences in a model
+   *
+   * Each variable has a record with the index of its declaration item
+   * in the model and a segment of a shared pool that lists the items the
+   * variable occurs in. For the flat model, the number of the record is
+   * stored in the VarDecl itself. Other models also look up declarations
+   * by name (e.g. flat variables in the output model), so they keep the
+   * record numbers in a map.
+   *
+   * A segment that runs out of space moves to the end of the pool, and
+   * removing an occurrence moves the last entry of the segment into its
+   * place. Occurrences in long segments are located using a hash table
+   * of (variable, item) pairs, short segments are searched linearly.
+   * Occurrences in removed items are only dropped by compact(), which
+   * also reclaims the space left behind by moved segments.
+   */
   class VarOccurrences {
   public:
-    typedef UNORDERED_NAMESPACE::unordered_set<Item*> Items;
-    IdMap<Items> _m;
-    IdMap<int> idx;
+    /// Items a variable occurs in (invalidated when its occurrences change)
+    class Items {
+      friend class VarOccurrences;
+    protected:
+      /// The index
+      const VarOccurrences* _vo;
+      /// Record of the variable, or -1
+      int _r;
+      /// Constructor
+      Items(const VarOccurrences* vo, int r) : _vo(vo), _r(r) {}
+    public:
+      /// Return number of items
+      unsigned int size(void) const {
+        return _r==-1 ? 0 : _vo->_vars[_r].size;
+      }
+      /// Return item \a i
+      Item* operator[](unsigned int i) const {
+        assert(i < size());
+        return _vo->_pool[_vo->_vars[_r].start+i];
+      }
+    };
+  protected:
+    /// Record of a variable
+    struct Var {
+      /// The declaration
+      VarDecl* vd;
+      /// Index of the declaration item in the model, or -1
+      int idx;
+      /// Start of the segment in the pool
+      unsigned int start;
+      /// Number of occurrences
+      unsigned int size;
+      /// Capacity of the segment
+      unsigned int cap;
+    };
+    /// Entry of the occurrence table (the item is found in the pool)
+    struct Occ {
+      /// Record of the variable (or occ_empty, occ_deleted)
+      unsigned int var;
+      /// Position of the item in the segment of the variable
+      unsigned int pos;
+    };
+    /// Record number of empty table entries
+    static const unsigned int occ_empty = 0xFFFFFFFF;
+    /// Record number of deleted table entries
+    static const unsigned int occ_deleted = 0xFFFFFFFE;
+    /// Whether record numbers are stored in the VarDecls
+    bool _declIdx;
+    /// Record numbers by name (if not stored in the VarDecls)
+    IdMap<int> _byName;
+    /// The records
+    std::vector<Var> _vars;
+    /// The pool of occurrence segments
+    std::vector<Item*> _pool;
+    /// Number of pool entries not used by any segment
+    size_t _garbage;
+    /// Hash table of occurrences
+    std::vector<Occ> _occ;
+    /// Number of occurrences in the table
+    size_t _occLive;
+    /// Number of occupied (live or deleted) table entries
+    size_t _occUsed;
+    /// Segments up to this capacity are searched linearly instead of using the table
+    static const unsigned int short_list = 8;
+
+    /// Return record of \a vd, or -1
+    int record(VarDecl* vd);
+    /// Return record of \a vd, creating it if necessary
+    int addRecord(VarDecl* vd);
+    /// Return table entry of \a i in record \a r, or the empty entry where it belongs
+    size_t lookup(unsigned int r, Item* i) const;
+    /// Insert \a i at position \a pos of record \a r into the table
+    void insertOcc(unsigned int r, Item* i, unsigned int pos);
+    /// Rebuild the table with space for \a n occurrences
+    void rehash(size_t n);
+    /// Return position of \a i in record \a r, or -1
+    int position(unsigned int r, Item* i) const;
+    /// Add \a i to record \a r unless present
+    void addOcc(unsigned int r, Item* i);
+    /// Remove \a i from record \a r if present
+    void removeOcc(unsigned int r, Item* i);
+    /// Resize the pool to \a n entries, growing its capacity by half if necessary
+    void growPool(size_t n);
+    /// Compact the pool, dropping removed items if \a dropRemoved
+    void compactPool(bool dropRemoved);
+  public:
+    /// Constructor (storing record numbers in the VarDecls if \a declIdx)
+    VarOccurrences(bool declIdx = false);
 
     /// Add \a to the index
     void add(VarDeclI* i, int idx_i);
@@ -41,10 +143,16 @@ namespace MiniZinc {
     
     /// Return number of occurrences of \a v
     int occurrences(VarDecl* v);
+
+    /// Return items that \a v occurs in
+    Items items(VarDecl* v);
     
     /// Unify \a v0 and \a v1 (removing \a v0)
     void unify(EnvI& env, Model* m, Id* id0, Id* id1);
     
+    /// Drop occurrences in removed items and reclaim unused space
+    void compact(void);
+
     /// Clear all entries
     void clear(void);
   };
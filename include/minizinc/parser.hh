@@ -34,6 +34,7 @@ extern "C" int isatty(int);
 
 #include <minizinc/model.hh>
 #include <minizinc/parser.tab.hh>
+#include <minizinc/file_utils.hh>
 
 #include <string>
 #include <vector>
@@ -49,12 +50,12 @@ namespace MiniZinc {
   class ParserState {
   public:
     ParserState(const std::string& f,
-                const std::string& b, std::ostream& err0,
+                const char* b, unsigned int length0, std::ostream& err0,
                 std::vector<std::pair<std::string,Model*> >& files0,
                 std::map<std::string,Model*>& seenModels0,
                 MiniZinc::Model* model0,
                 bool isDatafile0, bool isFlatZinc0, bool parseDocComments0)
-    : filename(f.c_str()), buf(b.c_str()), pos(0), length(b.size()),
+    : filename(f.c_str()), buf(b), pos(0), length(length0), source(NULL),
       lineno(1), lineStartPos(0), nTokenNextStart(1),
       files(files0), seenModels(seenModels0), model(model0),
       isDatafile(isDatafile0), isFlatZinc(isFlatZinc0), parseDocComments(parseDocComments0),
@@ -63,8 +64,11 @@ namespace MiniZinc {
     const char* filename;
   
     void* yyscanner;
+    /// The source text (not necessarily NUL-terminated)
     const char* buf;
     unsigned int pos, length;
+    /// The source file the lexer scans in place (if any)
+    FileUtils::SourceFile* source;
 
     int lineno;
 
@@ -84,15 +88,15 @@ namespace MiniZinc {
     std::string stringBuffer;
 
     void printCurrentLine(void) {
-      const char* eol_c = strchr(buf+lineStartPos,'\n');
-      if (eol_c) {
-        err << std::string(buf+lineStartPos,eol_c-(buf+lineStartPos));
-      } else {
-        err << buf+lineStartPos;
+      if (static_cast<unsigned int>(lineStartPos) <= length) {
+        const char* bol = buf+lineStartPos;
+        const char* eol_c = static_cast<const char*>(memchr(bol,'\n',length-lineStartPos));
+        err << std::string(bol, eol_c ? eol_c-bol : buf+length-bol);
       }
       err << std::endl;
     }
   
+    /// Copy input to the lexer (only used if the lexer does not scan the text in place)
     int fillBuffer(char* lexBuf, unsigned int lexBufSize) {
       if (pos >= length)
         return 0;
@@ -104,17 +108,21 @@ namespace MiniZinc {
 
   };
 
+  /// Parse \a filename, caching parsed library files in \a cacheDir unless it is empty
   Model* parse(const std::string& filename,
                const std::vector<std::string>& datafiles,
                const std::vector<std::string>& includePaths,
                bool ignoreStdlib, bool parseDocComments, bool verbose,
-               std::ostream& err);
+               std::ostream& err,
+               const std::string& cacheDir="");
 
+  /// Parse model text \a model, caching parsed library files in \a cacheDir unless it is empty
   Model* parseFromString(const std::string& model,
                          const std::string& filename,
                          const std::vector<std::string>& includePaths,
                          bool ignoreStdlib, bool parseDocComments, bool verbose,
-                         std::ostream& err);
+                         std::ostream& err,
+                         const std::string& cacheDir="");
 
   Model* parseData(Model* m,
                    const std::vector<std::string>& datafiles,
@@ -0,0 +1,63 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_PARSER_CACHE_HH__
+#define __MINIZINC_PARSER_CACHE_HH__
+
+#include <string>
+
+#include <minizinc/model.hh>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Cache of parsed library files
+   *
+   * The items of a parsed file are stored in a binary snapshot in
+   * directory \a cacheDir. A snapshot is named after the full path of the
+   * file, and records a hash of the file contents, so it is only used
+   * while the file is unchanged. Include items are restored without
+   * their included models, which the caller has to add (as the parser
+   * does for include items it reads).
+   *
+   * In resident mode, snapshots are also kept in memory, so that a
+   * long-running process (such as mzn2fzn --server or --batch) parses each
+   * library file only once. If requested, the parser then also keeps the
+   * main model file in memory (but never writes it to the cache
+   * directory). This only pays off when the same model is compiled
+   * repeatedly (as in mzn2fzn --batch). An empty \a cacheDir disables
+   * the snapshot files.
+   */
+
+  /// Set whether snapshots are kept in memory (turning it off clears them)
+  void residentParseCache(bool b);
+  /// Return whether snapshots are kept in memory
+  bool residentParseCache(void);
+  /// Remove all snapshots kept in memory
+  void clearResidentParseCache(void);
+  /// Set whether the main model file is kept in memory in resident mode
+  void residentMainModel(bool b);
+  /// Return whether the main model file is kept in memory in resident mode
+  bool residentMainModel(void);
+
+  /// Read items of file \a fullname with \a size bytes of contents \a contents from the cache into \a m
+  bool readParseCache(const std::string& cacheDir, const std::string& fullname,
+                      const char* contents, size_t size, bool parseDocComments, Model* m);
+
+  /// Write items of \a m, parsed from \a fullname with \a size bytes of contents \a contents,
+  /// to the cache (leaving out the \a first items, which were not read from the file)
+  bool writeParseCache(const std::string& cacheDir, const std::string& fullname,
+                       const char* contents, size_t size, bool parseDocComments, Model* m,
+                       unsigned int first=0);
+
+}
+
+#endif
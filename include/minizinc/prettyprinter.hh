@@ -22,6 +22,7 @@ namespace MiniZinc {
   class Document;
   class ItemDocumentMapper;
   class PrettyPrinter;
+  class FdBuffer;
 
   class Printer {
   private:
@@ -46,6 +47,35 @@ namespace MiniZinc {
 
   };
 
+  /**
+   * \brief Printer for unformatted output to a file descriptor
+   *
+   * Produces the same output as a Printer with width 0, but formats
+   * into a large buffer that is written to the file descriptor directly,
+   * bypassing the iostreams library. It can also append its output to
+   * a string.
+   */
+  class FdPrinter {
+  private:
+    FdBuffer* _out;
+    bool _flatZinc;
+  public:
+    FdPrinter(int fd, bool flatZinc=true);
+    /// Constructor for printing to the end of \a s
+    FdPrinter(std::string& s, bool flatZinc=true);
+    /// Destructor, flushes the buffer
+    ~FdPrinter(void);
+
+    void print(const Expression* e);
+    void print(const Item* i);
+    void print(const Model* m);
+
+    /// Write buffered output, return false if an I/O error occurred
+    bool flush(void);
+    /// Return number of bytes printed so far
+    unsigned long long int bytesWritten(void) const;
+  };
+
   /// Output operator for expressions
   template<class Char, class Traits>
   std::basic_ostream<Char,Traits>&
@@ -0,0 +1,140 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_PROFILER_HH__
+#define __MINIZINC_PROFILER_HH__
+
+#include <minizinc/ast.hh>
+#include <minizinc/timer.hh>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Profile of flattening by source location and called predicate
+   *
+   * The flattener enters a scope for each top-level item and each call
+   * it flattens. For every source line and every predicate, the profiler
+   * records the time spent, the variables and constraints added to the
+   * flat model, and the memory allocated by the garbage collector. The
+   * total cost includes nested scopes, the self cost excludes them.
+   */
+  class Profiler {
+  public:
+    /// Resources used while flattening
+    struct Cost {
+      /// Wall time (in milliseconds)
+      double time;
+      /// Number of variable declaration items added to the flat model
+      unsigned long long int vars;
+      /// Number of constraint items added to the flat model
+      unsigned long long int constraints;
+      /// Bytes allocated by the garbage collector
+      unsigned long long int bytes;
+      /// Constructor
+      Cost(void) : time(0.0), vars(0), constraints(0), bytes(0) {}
+      /// Add \a c
+      Cost& operator +=(const Cost& c) {
+        time += c.time; vars += c.vars; constraints += c.constraints; bytes += c.bytes;
+        return *this;
+      }
+      /// Subtract \a c
+      Cost& operator -=(const Cost& c) {
+        time -= c.time; vars -= c.vars; constraints -= c.constraints; bytes -= c.bytes;
+        return *this;
+      }
+    };
+    /// Profile of a source location or predicate
+    struct Entry {
+      /// Source location or predicate name
+      std::string name;
+      /// Number of times a scope was entered
+      unsigned long long int count;
+      /// Cost including nested scopes (recursive scopes are counted once)
+      Cost total;
+      /// Cost excluding nested scopes
+      Cost self;
+      /// Number of currently active scopes
+      int active;
+      /// Constructor
+      Entry(void) : count(0), active(0) {}
+    };
+  protected:
+    /// An active scope
+    struct Frame {
+      /// Entry for the source location
+      Entry* loc;
+      /// Entry for the predicate, or NULL
+      Entry* pred;
+      /// Timer started when entering the scope
+      Timer timer;
+      /// Counters when entering the scope
+      Cost start;
+      /// Total cost of nested scopes
+      Cost children;
+    };
+    /// Profiles by source location
+    std::map<std::string,Entry> _locations;
+    /// Profiles by predicate
+    std::map<std::string,Entry> _predicates;
+    /// Active scopes
+    std::vector<Frame> _stack;
+    /// Number of variable declaration items added so far
+    unsigned long long int _vars;
+    /// Number of constraint items added so far
+    unsigned long long int _constraints;
+    /// Return current counters (time is zero)
+    Cost counters(void) const;
+  public:
+    /// Constructor
+    Profiler(void);
+    /// Enter scope for flattening code at \a loc, calling predicate \a pred unless empty
+    void enter(const Location& loc, const ASTString& pred);
+    /// Exit innermost scope
+    void exit(void);
+    /// Record that item \a i was added to the flat model
+    void addItem(Item* i);
+    /// Return profiles by source location, most expensive (self time) first
+    std::vector<const Entry*> locations(void) const;
+    /// Return profiles by predicate, most expensive (self time) first
+    std::vector<const Entry*> predicates(void) const;
+    /// Print tables of the \a n most expensive locations and predicates to \a os
+    void print(std::ostream& os, unsigned int n) const;
+    /// Print profile as JSON to \a os
+    void printJSON(std::ostream& os) const;
+  };
+
+  /// Profiler scope, which is only active if a profiler is given
+  class ProfileScope {
+  protected:
+    /// The profiler, or NULL
+    Profiler* _p;
+  public:
+    /// Enter scope of \a p (if not NULL) for code at \a loc calling \a pred
+    ProfileScope(Profiler* p, const Location& loc, const ASTString& pred = ASTString())
+      : _p(p) {
+      if (_p)
+        _p->enter(loc, pred);
+    }
+    /// Exit scope
+    ~ProfileScope(void) {
+      if (_p)
+        _p->exit();
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_STATISTICS_HH__
+#define __MINIZINC_STATISTICS_HH__
+
+#include <minizinc/flatten.hh>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Statistics of a compilation run
+   *
+   * Collects the time spent in each compilation phase, the
+   * statistics of the flat model, the effectiveness of common
+   * subexpression elimination and the overload cache, and
+   * the memory and pause times of the garbage collector.
+   */
+  struct CompilerStatistics {
+    /// Phase names and times (in milliseconds), in the order they ran
+    std::vector<std::pair<std::string,double> > phases;
+    /// Overall time (in milliseconds)
+    double time;
+    /// Statistics of the flat model
+    FlatModelStatistics flat;
+    /// Number of CSE lookups
+    unsigned long long int cse_lookups;
+    /// Number of CSE lookups that found a reusable result
+    unsigned long long int cse_hits;
+    /// Number of overloads resolved from the cache
+    unsigned long long int fn_cache_hits;
+    /// Number of overloads resolved without the cache
+    unsigned long long int fn_cache_misses;
+    /// Maximum allocated memory (high water mark, in bytes)
+    size_t gc_max_mem;
+    /// Memory occupied by objects (in bytes)
+    size_t gc_used_mem;
+    /// Total number of bytes allocated
+    unsigned long long int gc_allocated;
+    /// Number of garbage collections
+    unsigned int gc_collections;
+    /// Total time spent in collector pauses (in milliseconds)
+    double gc_pause_time;
+    /// Longest collector pause (in milliseconds)
+    double gc_max_pause_time;
+    /// Constructor
+    CompilerStatistics(void);
+    /// Record that phase \a name took \a ms milliseconds
+    void phase(const std::string& name, double ms);
+    /// Collect flat model, CSE and overload cache statistics from \a env
+    void collect(Env& env);
+    /// Collect garbage collector statistics of the current thread
+    void collectGC(void);
+    /// Return fraction of CSE lookups that found a reusable result
+    double cseHitRate(void) const;
+    /// Print statistics as JSON to \a os
+    void printJSON(std::ostream& os) const;
+  };
+
+  /// Print \a s as a JSON string to \a os
+  void printJSONString(std::ostream& os, const std::string& s);
+
+}
+
+#endif
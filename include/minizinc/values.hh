@@ -57,8 +57,28 @@ namespace MiniZinc {
 
 #undef MZN_NORETURN
 
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_add_overflow)
+#define MZN_HAS_OVERFLOW_BUILTINS
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 5
+#define MZN_HAS_OVERFLOW_BUILTINS
+#endif
+
 namespace MiniZinc {
   
+  /**
+   * \brief Integer value, possibly infinite
+   *
+   * Values are stored in a single 64 bit integer. The largest and
+   * smallest representable integers encode plus and minus infinity, so
+   * finite values range from LLONG_MIN+1 to LLONG_MAX-1. Arithmetic
+   * throws an ArithmeticError on overflow and on infinite operands, and
+   * so does constructing a value from one of the encodings (use
+   * infinity() instead). Integer literals in models and data files are
+   * limited to plus or minus LLONG_MAX-1, so LLONG_MIN+1 can only be
+   * the result of an operation.
+   */
   class IntVal {
     friend IntVal operator +(const IntVal& x, const IntVal& y);
     friend IntVal operator -(const IntVal& x, const IntVal& y);
@@ -67,80 +87,139 @@ namespace MiniZinc {
     friend IntVal operator %(const IntVal& x, const IntVal& y);
     friend IntVal std::abs(const MiniZinc::IntVal& x);
     friend bool operator ==(const IntVal& x, const IntVal& y);
+    friend bool operator <=(const IntVal& x, const IntVal& y);
+    friend bool operator <(const IntVal& x, const IntVal& y);
   private:
+    /// The value (or one of the infinity encodings)
     long long int _v;
-    bool _infinity;
-    IntVal(long long int v, bool infinity) : _v(v), _infinity(infinity) {}
+    /// Encoding of plus infinity
+    static const long long int PLUS_INF = LLONG_MAX;
+    /// Encoding of minus infinity
+    static const long long int MINUS_INF = LLONG_MIN;
+    /// Construct from finite result \a v of an operation (no check)
+    struct Raw {};
+    IntVal(long long int v, Raw) : _v(v) {}
+    /// Throw error for infinite operands
+    static void infiniteOperand(void) {
+      throw ArithmeticError("arithmetic operation on infinite value");
+    }
+    /// Return result \a r of an operation, checking \a overflow and the infinity encodings
+    static IntVal result(long long int r, bool overflow) {
+      if (overflow || r==PLUS_INF || r==MINUS_INF)
+        MiniZincSafeIntExceptionHandler::SafeIntOnOverflow();
+      return IntVal(r,Raw());
+    }
+    /// Add finite values \a x and \a y
+    static IntVal add(long long int x, long long int y) {
+#ifdef MZN_HAS_OVERFLOW_BUILTINS
+      long long int r;
+      bool o = __builtin_add_overflow(x,y,&r);
+      return result(r,o);
+#else
+      return result(SI(x)+SI(y),false);
+#endif
+    }
+    /// Subtract finite value \a y from \a x
+    static IntVal sub(long long int x, long long int y) {
+#ifdef MZN_HAS_OVERFLOW_BUILTINS
+      long long int r;
+      bool o = __builtin_sub_overflow(x,y,&r);
+      return result(r,o);
+#else
+      return result(SI(x)-SI(y),false);
+#endif
+    }
+    /// Multiply finite values \a x and \a y
+    static IntVal mul(long long int x, long long int y) {
+#ifdef MZN_HAS_OVERFLOW_BUILTINS
+      long long int r;
+      bool o = __builtin_mul_overflow(x,y,&r);
+      return result(r,o);
+#else
+      return result(SI(x)*SI(y),false);
+#endif
+    }
+    /// Divide finite value \a x by \a y
+    static IntVal div(long long int x, long long int y) {
+      if (y==0)
+        MiniZincSafeIntExceptionHandler::SafeIntOnDivZero();
+      return result(x/y,false);
+    }
+    /// Return remainder of dividing finite value \a x by \a y
+    static IntVal mod(long long int x, long long int y) {
+      if (y==0)
+        MiniZincSafeIntExceptionHandler::SafeIntOnDivZero();
+      return IntVal(x%y,Raw());
+    }
+#ifndef MZN_HAS_OVERFLOW_BUILTINS
     typedef SafeInt<long long int, MiniZincSafeIntExceptionHandler> SI;
-    SI toSafeInt(void) const { return _v; }
-    IntVal(SI v) : _v(v), _infinity(false) {}
+#endif
   public:
-    IntVal(void) : _v(0), _infinity(false) {}
-    IntVal(long long int v) : _v(v), _infinity(false) {}
+    IntVal(void) : _v(0) {}
+    IntVal(long long int v) : _v(v) {
+      if (v==PLUS_INF || v==MINUS_INF)
+        MiniZincSafeIntExceptionHandler::SafeIntOnOverflow();
+    }
     
     long long int toInt(void) const {
       if (!isFinite())
-        throw ArithmeticError("arithmetic operation on infinite value");
+        infiniteOperand();
       return _v;
     }
     
-    bool isFinite(void) const { return !_infinity; }
-    bool isPlusInfinity(void) const { return _infinity && _v==1; }
-    bool isMinusInfinity(void) const { return _infinity && _v==-1; }
+    bool isFinite(void) const { return _v!=PLUS_INF && _v!=MINUS_INF; }
+    bool isPlusInfinity(void) const { return _v==PLUS_INF; }
+    bool isMinusInfinity(void) const { return _v==MINUS_INF; }
     
     IntVal& operator +=(const IntVal& x) {
       if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v = toSafeInt() + x.toSafeInt();
-      return *this;
+        infiniteOperand();
+      return *this = add(_v,x._v);
     }
     IntVal& operator -=(const IntVal& x) {
       if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v = toSafeInt() - x.toSafeInt();
-      return *this;
+        infiniteOperand();
+      return *this = sub(_v,x._v);
     }
     IntVal& operator *=(const IntVal& x) {
       if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v = toSafeInt() * x.toSafeInt();
-      return *this;
+        infiniteOperand();
+      return *this = mul(_v,x._v);
     }
     IntVal& operator /=(const IntVal& x) {
       if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v = toSafeInt() / x.toSafeInt();
-      return *this;
+        infiniteOperand();
+      return *this = div(_v,x._v);
     }
     IntVal operator -() const {
-      IntVal r = *this;
-      r._v = -r.toSafeInt();
-      return r;
+      if (isPlusInfinity())
+        return IntVal(MINUS_INF,Raw());
+      if (isMinusInfinity())
+        return IntVal(PLUS_INF,Raw());
+      return result(-_v,false);
     }
     IntVal& operator ++() {
       if (!isFinite())
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v = toSafeInt() + 1;
-      return *this;
+        infiniteOperand();
+      return *this = add(_v,1);
     }
     IntVal operator ++(int) {
       if (!isFinite())
-        throw ArithmeticError("arithmetic operation on infinite value");
+        infiniteOperand();
       IntVal ret = *this;
-      _v = toSafeInt() + 1;
+      *this = add(_v,1);
       return ret;
     }
     IntVal& operator --() {
       if (!isFinite())
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v = toSafeInt() - 1;
-      return *this;
+        infiniteOperand();
+      return *this = sub(_v,1);
     }
     IntVal operator --(int) {
       if (!isFinite())
-        throw ArithmeticError("arithmetic operation on infinite value");
+        infiniteOperand();
       IntVal ret = *this;
-      _v = toSafeInt() - 1;
+      *this = sub(_v,1);
       return ret;
     }
     static const IntVal minint(void);
@@ -148,16 +227,16 @@ namespace MiniZinc {
     static const IntVal infinity(void);
     
     /// Infinity-safe addition
-    IntVal plus(int x) {
+    IntVal plus(int x) const {
       if (isFinite())
-        return toSafeInt()+x;
+        return add(_v,x);
       else
         return *this;
     }
     /// Infinity-safe subtraction
-    IntVal minus(int x) {
+    IntVal minus(int x) const {
       if (isFinite())
-        return toSafeInt()-x;
+        return sub(_v,x);
       else
         return *this;
     }
@@ -171,18 +250,15 @@ namespace MiniZinc {
 
   inline
   bool operator ==(const IntVal& x, const IntVal& y) {
-    return x._infinity==y._infinity && x._v == y._v;
+    return x._v == y._v;
   }
   inline
   bool operator <=(const IntVal& x, const IntVal& y) {
-    return y.isPlusInfinity() || x.isMinusInfinity() || (x.isFinite() && y.isFinite() && x.toInt() <= y.toInt());
+    return x._v <= y._v;
   }
   inline
   bool operator <(const IntVal& x, const IntVal& y) {
-    return
-      (y.isPlusInfinity() && !x.isPlusInfinity()) ||
-      (x.isMinusInfinity() && !y.isMinusInfinity()) ||
-      (x.isFinite() && y.isFinite() && x.toInt() < y.toInt());
+    return x._v < y._v;
   }
   inline
   bool operator >=(const IntVal& x, const IntVal& y) {
@@ -199,32 +275,32 @@ namespace MiniZinc {
   inline
   IntVal operator +(const IntVal& x, const IntVal& y) {
     if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toSafeInt()+y.toSafeInt();
+      IntVal::infiniteOperand();
+    return IntVal::add(x._v,y._v);
   }
   inline
   IntVal operator -(const IntVal& x, const IntVal& y) {
     if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toSafeInt()-y.toSafeInt();
+      IntVal::infiniteOperand();
+    return IntVal::sub(x._v,y._v);
   }
   inline
   IntVal operator *(const IntVal& x, const IntVal& y) {
     if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toSafeInt()*y.toSafeInt();
+      IntVal::infiniteOperand();
+    return IntVal::mul(x._v,y._v);
   }
   inline
   IntVal operator /(const IntVal& x, const IntVal& y) {
     if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toInt()/y.toInt();
+      IntVal::infiniteOperand();
+    return IntVal::div(x._v,y._v);
   }
   inline
   IntVal operator %(const IntVal& x, const IntVal& y) {
     if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toInt()%y.toInt();
+      IntVal::infiniteOperand();
+    return IntVal::mod(x._v,y._v);
   }
   template<class Char, class Traits>
   std::basic_ostream<Char,Traits>&
@@ -243,8 +319,7 @@ namespace std {
   inline
   MiniZinc::IntVal abs(const MiniZinc::IntVal& x) {
     if (!x.isFinite()) return MiniZinc::IntVal::infinity();
-    MiniZinc::IntVal::SI y(x.toInt());
-    return y < 0 ? MiniZinc::IntVal(static_cast<long long int>(-y)) : x;
+    return x._v < 0 ? -x : x;
   }
   
   inline
@@ -305,22 +380,64 @@ namespace MiniZinc {
     const Range& get(int i) const {
       return reinterpret_cast<const Range*>(_data)[i];
     }
-    /// Construct empty set
-    IntSetVal(void) : ASTChunk(0) {}
-    /// Construct set of single range
-    IntSetVal(IntVal m, IntVal n);
-    /// Construct set from \a s
-    IntSetVal(const std::vector<Range>& s)
-      : ASTChunk(sizeof(Range)*s.size()) {
-      for (unsigned int i=s.size(); i--;)
-        get(i) = s[i];
+    /// Construct set from the \a n ranges \a r
+    IntSetVal(const Range* r, int n)
+      : ASTChunk(sizeof(Range)*n) {
+      for (int i=n; i--;)
+        get(i) = r[i];
     }
+    /// Return interned set of the \a n ranges \a r, allocating it if necessary
+    static IntSetVal* intern(const Range* r, int n);
 
     /// Disabled
     IntSetVal(const IntSetVal& r);
     /// Disabled
     IntSetVal& operator =(const IntSetVal& r);
   public:
+    /// Ranges under construction, kept on the stack unless there are many
+    class RangeBuffer {
+    protected:
+      /// Number of ranges stored locally
+      static const int local = 16;
+      /// Local storage
+      Range _local[local];
+      /// Heap storage (used once more than \a local ranges are added)
+      std::vector<Range> _heap;
+      /// Number of ranges
+      int _n;
+    public:
+      /// Constructor
+      RangeBuffer(void) : _n(0) {}
+      /// Return number of ranges
+      int size(void) const { return _n; }
+      /// Return the ranges
+      const Range* ranges(void) const { return _n <= local ? _local : &_heap[0]; }
+      /// Return last range
+      Range& back(void) { return _n <= local ? _local[_n-1] : _heap.back(); }
+      /// Add range from \a m to \a n, which must lie above all ranges so far
+      void push(IntVal m, IntVal n) {
+        if (_n < local) {
+          _local[_n] = Range(m,n);
+        } else {
+          if (_n == local)
+            _heap.assign(_local,_local+local);
+          _heap.push_back(Range(m,n));
+        }
+        _n++;
+      }
+      /// Add range from \a m to \a n, merging it with an adjacent last range
+      void merge(IntVal m, IntVal n) {
+        if (_n > 0 && m <= back().max.plus(1)) {
+          if (n > back().max)
+            back().max = n;
+        } else {
+          push(m,n);
+        }
+      }
+      /// Return interned set of the ranges
+      IntSetVal* a(void) const { return intern(ranges(),_n); }
+    };
+
     /// Return number of ranges
     int size(void) const { return _size / sizeof(Range); }
     /// Return minimum, or infinity if set is empty
@@ -351,11 +468,12 @@ namespace MiniZinc {
       return c;
     }
 
+    /// Return hash value of the \a n ranges \a r
+    static size_t hash(const Range* r, int n);
+
     /// Allocate empty set from context
     static IntSetVal* a(void) {
-      IntSetVal* r = static_cast<IntSetVal*>(ASTChunk::alloc(0));
-      new (r) IntSetVal();
-      return r;
+      return intern(NULL,0);
     }
     
     /// Allocate set \f$\{m,n\}\f$ from context
@@ -363,63 +481,56 @@ namespace MiniZinc {
       if (m>n) {
         return a();
       } else {
-        IntSetVal* r =
-          static_cast<IntSetVal*>(ASTChunk::alloc(sizeof(Range)));
-        new (r) IntSetVal(m,n);
-        return r;
+        Range r(m,n);
+        return intern(&r,1);
       }
     }
 
     /// Allocate set using iterator \a i
     template<class I>
     static IntSetVal* ai(I& i) {
-      std::vector<Range> s;
+      RangeBuffer b;
       for (; i(); ++i)
-        s.push_back(Range(i.min(),i.max()));
-      IntSetVal* r = static_cast<IntSetVal*>(
-          ASTChunk::alloc(sizeof(Range)*s.size()));
-      new (r) IntSetVal(s);
-      return r;
+        b.push(i.min(),i.max());
+      return b.a();
     }
     
     /// Allocate set from vector \a s0 (may contain duplicates)
-    static IntSetVal* a(const std::vector<IntVal>& s0) {
-      if (s0.size()==0)
-        return a();
-      std::vector<IntVal> s=s0;
-      std::sort(s.begin(),s.end());
-      std::vector<Range> ranges;
-      IntVal min=s[0];
-      IntVal max=min;
-      for (unsigned int i=1; i<s.size(); i++) {
-        if (s[i]>max+1) {
-          ranges.push_back(Range(min,max));
-          min=s[i]; max=min;
-        } else {
-          max=s[i];
-        }
-      }
-      ranges.push_back(Range(min,max));
-      IntSetVal* r = static_cast<IntSetVal*>(
-          ASTChunk::alloc(sizeof(Range)*ranges.size()));
-      new (r) IntSetVal(ranges);
-      return r;
-    }
+    static IntSetVal* a(const std::vector<IntVal>& s0);
     static IntSetVal* a(const std::vector<Range>& ranges) {
-      IntSetVal* r = static_cast<IntSetVal*>(ASTChunk::alloc(sizeof(Range)*ranges.size()));
-      new (r) IntSetVal(ranges);
-      return r;
+      return ranges.empty() ? a() : intern(&ranges[0],static_cast<int>(ranges.size()));
     }
+
+    /// Return union of \a s0 and \a s1
+    static IntSetVal* unite(IntSetVal* s0, IntSetVal* s1);
+    /// Return intersection of \a s0 and \a s1
+    static IntSetVal* intersect(IntSetVal* s0, IntSetVal* s1);
+    /// Return \a s0 without the elements of \a s1
+    static IntSetVal* diff(IntSetVal* s0, IntSetVal* s1);
+    /// Return symmetric difference of \a s0 and \a s1
+    static IntSetVal* symdiff(IntSetVal* s0, IntSetVal* s1);
+    /// Return intersection of \a s with \f$\{m..n\}\f$
+    static IntSetVal* intersect(IntSetVal* s, IntVal m, IntVal n);
+    /// Return \a s without \a v
+    static IntSetVal* remove(IntSetVal* s, IntVal v);
     
-    /// Check if set contains \a v
-    bool contains(const IntVal& v) {
-      for (int i=0; i<size(); i++) {
-        if (v < min(i))
-          return false;
-        if (v <= max(i))
-          return true;
+    /// Return index of the range containing \a v, or of the first range above \a v
+    int find(const IntVal& v) const {
+      int lo = 0;
+      int hi = size();
+      while (lo < hi) {
+        int m = lo + (hi-lo)/2;
+        if (max(m) < v)
+          lo = m+1;
+        else
+          hi = m;
       }
-      return false;
+      return lo;
+    }
+    /// Check if set contains \a v
+    bool contains(const IntVal& v) const {
+      int i = find(v);
+      return i < size() && min(i) <= v;
     }
     
     /// Check if it is equal to \a s
@@ -434,7 +545,7 @@ namespace MiniZinc {
     
     /// Mark for garbage collection
     void mark(void) {
-      _gc_mark = 1;
+      gcMark();
     }
   };
   
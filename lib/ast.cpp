@@ -69,86 +69,91 @@ namespace MiniZinc {
       const Expression* cur = stack.back(); stack.pop_back();
       if (cur->_gc_mark==0) {
         cur->_gc_mark = 1;
-        cur->loc().mark();
-        pushann(cur->ann());
-        switch (cur->eid()) {
-        case Expression::E_INTLIT:
-        case Expression::E_FLOATLIT:
-        case Expression::E_BOOLLIT:
-        case Expression::E_ANON:
-          break;
-        case Expression::E_SETLIT:
-          if (cur->cast<SetLit>()->isv())
-            cur->cast<SetLit>()->isv()->mark();
-          else
-            pushall(cur->cast<SetLit>()->v());
-          break;
-        case Expression::E_STRINGLIT:
-          cur->cast<StringLit>()->v().mark();
-          break;
-        case Expression::E_ID:
-          if (cur->cast<Id>()->idn()==-1)
-            cur->cast<Id>()->v().mark();
-          pushstack(cur->cast<Id>()->decl());
-          break;
-        case Expression::E_ARRAYLIT:
-          pushall(cur->cast<ArrayLit>()->v());
-          cur->cast<ArrayLit>()->_dims.mark();
-          break;
-        case Expression::E_ARRAYACCESS:
-          pushstack(cur->cast<ArrayAccess>()->v());
-          pushall(cur->cast<ArrayAccess>()->idx());
-          break;
-        case Expression::E_COMP:
-          pushstack(cur->cast<Comprehension>()->_e);
-          pushstack(cur->cast<Comprehension>()->_where);
-          pushall(cur->cast<Comprehension>()->_g);
-          cur->cast<Comprehension>()->_g_idx.mark();
-          break;
-        case Expression::E_ITE:
-          pushstack(cur->cast<ITE>()->e_else());
-          pushall(cur->cast<ITE>()->_e_if_then);
-          break;
-        case Expression::E_BINOP:
-          pushstack(cur->cast<BinOp>()->lhs());
-          pushstack(cur->cast<BinOp>()->rhs());
-          break;
-        case Expression::E_UNOP:
-          pushstack(cur->cast<UnOp>()->e());
-          break;
-        case Expression::E_CALL:
-          cur->cast<Call>()->id().mark();
-          pushall(cur->cast<Call>()->_args);
-          if (FunctionI* fi = cur->cast<Call>()->_decl) {
-            fi->mark();
-            fi->id().mark();
-            pushstack(fi->ti());
-            pushann(fi->ann());
-            pushstack(fi->e());
-            pushall(fi->params());
-          }
-          break;
-        case Expression::E_VARDECL:
-          pushstack(cur->cast<VarDecl>()->ti());
-          pushstack(cur->cast<VarDecl>()->e());
-          pushstack(cur->cast<VarDecl>()->id());
-          break;
-        case Expression::E_LET:
-          pushall(cur->cast<Let>()->let());
-          pushall(cur->cast<Let>()->_let_orig);
-          pushstack(cur->cast<Let>()->in());
-          break;
-        case Expression::E_TI:
-          pushstack(cur->cast<TypeInst>()->domain());
-          pushall(cur->cast<TypeInst>()->ranges());
-          break;
-        case Expression::E_TIID:
-          cur->cast<TIId>()->v().mark();
-          break;
-        }
+        markChildren(cur, stack);
       }
     }
   }
+
+  void
+  Expression::markChildren(const Expression* cur, std::vector<const Expression*>& stack) {
+    cur->loc().mark();
+    pushann(cur->ann());
+    switch (cur->eid()) {
+    case Expression::E_INTLIT:
+    case Expression::E_FLOATLIT:
+    case Expression::E_BOOLLIT:
+    case Expression::E_ANON:
+      break;
+    case Expression::E_SETLIT:
+      if (cur->cast<SetLit>()->isv())
+        cur->cast<SetLit>()->isv()->mark();
+      else
+        pushall(cur->cast<SetLit>()->v());
+      break;
+    case Expression::E_STRINGLIT:
+      cur->cast<StringLit>()->v().mark();
+      break;
+    case Expression::E_ID:
+      if (cur->cast<Id>()->idn()==-1)
+        cur->cast<Id>()->v().mark();
+      pushstack(cur->cast<Id>()->decl());
+      break;
+    case Expression::E_ARRAYLIT:
+      pushall(cur->cast<ArrayLit>()->v());
+      cur->cast<ArrayLit>()->_dims.mark();
+      break;
+    case Expression::E_ARRAYACCESS:
+      pushstack(cur->cast<ArrayAccess>()->v());
+      pushall(cur->cast<ArrayAccess>()->idx());
+      break;
+    case Expression::E_COMP:
+      pushstack(cur->cast<Comprehension>()->_e);
+      pushstack(cur->cast<Comprehension>()->_where);
+      pushall(cur->cast<Comprehension>()->_g);
+      cur->cast<Comprehension>()->_g_idx.mark();
+      break;
+    case Expression::E_ITE:
+      pushstack(cur->cast<ITE>()->e_else());
+      pushall(cur->cast<ITE>()->_e_if_then);
+      break;
+    case Expression::E_BINOP:
+      pushstack(cur->cast<BinOp>()->lhs());
+      pushstack(cur->cast<BinOp>()->rhs());
+      break;
+    case Expression::E_UNOP:
+      pushstack(cur->cast<UnOp>()->e());
+      break;
+    case Expression::E_CALL:
+      cur->cast<Call>()->id().mark();
+      pushall(cur->cast<Call>()->_args);
+      if (FunctionI* fi = cur->cast<Call>()->_decl) {
+        fi->mark();
+        fi->id().mark();
+        pushstack(fi->ti());
+        pushann(fi->ann());
+        pushstack(fi->e());
+        pushall(fi->params());
+      }
+      break;
+    case Expression::E_VARDECL:
+      pushstack(cur->cast<VarDecl>()->ti());
+      pushstack(cur->cast<VarDecl>()->e());
+      pushstack(cur->cast<VarDecl>()->id());
+      break;
+    case Expression::E_LET:
+      pushall(cur->cast<Let>()->let());
+      pushall(cur->cast<Let>()->_let_orig);
+      pushstack(cur->cast<Let>()->in());
+      break;
+    case Expression::E_TI:
+      pushstack(cur->cast<TypeInst>()->domain());
+      pushall(cur->cast<TypeInst>()->ranges());
+      break;
+    case Expression::E_TIID:
+      cur->cast<TIId>()->v().mark();
+      break;
+    }
+  }
 #undef pushstack
 #undef pushall
 
@@ -166,6 +171,39 @@ namespace MiniZinc {
     cmb_hash(h(_v));
   }
 
+  namespace {
+    /// Test if an interned literal has a given value
+    template<class Lit, class Val>
+    class LitEq {
+    public:
+      const Val& v;
+      LitEq(const Val& v0) : v(v0) {}
+      bool operator()(const Lit* l) const { return l->v()==v; }
+    };
+  }
+
+  IntLit*
+  IntLit::a(MiniZinc::IntVal v) {
+    HASH_NAMESPACE::hash<IntVal> h;
+    size_t hv = h(v);
+    if (IntLit* il = GC::intLits().find<IntLit>(hv, LitEq<IntLit,IntVal>(v)))
+      return il;
+    IntLit* il = new IntLit(Location().introduce(), v);
+    GC::intLits().add(il,hv);
+    return il;
+  }
+
+  FloatLit*
+  FloatLit::a(MiniZinc::FloatVal v) {
+    HASH_NAMESPACE::hash<FloatVal> h;
+    size_t hv = h(v);
+    if (FloatLit* fl = GC::floatLits().find<FloatLit>(hv, LitEq<FloatLit,FloatVal>(v)))
+      return fl;
+    FloatLit* fl = new FloatLit(Location().introduce(), v);
+    GC::floatLits().add(fl,hv);
+    return fl;
+  }
+
   void
   SetLit::rehash(void) {
     init_hash();
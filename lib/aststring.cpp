@@ -22,19 +22,35 @@ namespace {
 
 namespace MiniZinc {
 
-  ASTStringO::ASTStringO(const std::string& s)
+  ASTStringO::ASTStringO(const std::string& s, size_t h)
     : ASTChunk(s.size()+sizeof(size_t)+1) {
     memcpy_s(_data+sizeof(size_t),s.size()+1,s.c_str(),s.size());
     *(_data+sizeof(size_t)+s.size())=0;
-    HASH_NAMESPACE::hash<std::string> h;
-    reinterpret_cast<size_t*>(_data)[0] = h(s);
+    reinterpret_cast<size_t*>(_data)[0] = h;
+  }
+
+  namespace {
+    /// Test if an interned string is equal to a given string
+    class StringEq {
+    public:
+      const std::string& s;
+      StringEq(const std::string& s0) : s(s0) {}
+      bool operator()(const ASTStringO* as) const {
+        return as->size()==s.size() && memcmp(as->c_str(), s.c_str(), s.size())==0;
+      }
+    };
   }
 
   ASTStringO*
   ASTStringO::a(const std::string& s) {
+    HASH_NAMESPACE::hash<std::string> h;
+    size_t hv = h(s);
+    if (ASTStringO* as = GC::strings().find<ASTStringO>(hv, StringEq(s)))
+      return as;
     ASTStringO* as =
       static_cast<ASTStringO*>(alloc(1+sizeof(size_t)+s.size()));
-    new (as) ASTStringO(s);
+    new (as) ASTStringO(s,hv);
+    GC::strings().add(as,hv);
     return as;
   }
   
@@ -746,10 +746,7 @@ namespace MiniZinc {
       throw EvalError(env, Location(), "upper bound of empty array undefined");
     IntSetVal* ub = b_ub_set(env,al->v()[0]);
     for (unsigned int i=1; i<al->v().size(); i++) {
-      IntSetRanges isr(ub);
-      IntSetRanges r(b_ub_set(env,al->v()[i]));
-      Ranges::Union<IntSetRanges,IntSetRanges> u(isr,r);
-      ub = IntSetVal::ai(u);
+      ub = IntSetVal::unite(ub,b_ub_set(env,al->v()[i]));
     }
     return ub;
   }
@@ -885,10 +882,7 @@ namespace MiniZinc {
       return IntSetVal::a();
     IntSetVal* isv = b_dom_varint(env,al->v()[0]);
     for (unsigned int i=1; i<al->v().size(); i++) {
-      IntSetRanges isr(isv);
-      IntSetRanges r(b_dom_varint(env,al->v()[i]));
-      Ranges::Union<IntSetRanges,IntSetRanges> u(isr,r);
-      isv = IntSetVal::ai(u);
+      isv = IntSetVal::unite(isv,b_dom_varint(env,al->v()[i]));
     }
     return isv;
   }
@@ -1518,10 +1512,7 @@ namespace MiniZinc {
       return IntSetVal::a();
     IntSetVal* isv = eval_intset(env,al->v()[0]);
     for (unsigned int i=0; i<al->v().size(); i++) {
-      IntSetRanges i0(isv);
-      IntSetRanges i1(eval_intset(env,al->v()[i]));
-      Ranges::Union<IntSetRanges, IntSetRanges> u(i0,i1);
-      isv = IntSetVal::ai(u);
+      isv = IntSetVal::unite(isv,eval_intset(env,al->v()[i]));
     }
     return isv;
   }
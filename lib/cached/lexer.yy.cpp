@@ -776,10 +776,13 @@ int yy_input_proc(char* buf, int size, yyscan_t yyscanner);
     yylloc->first_line = yylloc->last_line = parm->lineno; \
   }
 
+// Integer literals are unsigned (a minus sign is a separate unary
+// operator) and LLONG_MAX encodes infinity, so literals are limited to
+// LLONG_MAX-1, and negative ones to -(LLONG_MAX-1).
 bool strtointval(const char* s, long long int& v) {
   std::istringstream iss(s);
   iss >> v;
-  return !iss.fail();
+  return !iss.fail() && v != LLONG_MAX;
 }
 
 bool strtofloatval(const char* s, double& v) {
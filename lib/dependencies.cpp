@@ -0,0 +1,217 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/dependencies.hh>
+#include <minizinc/prettyprinter.hh>
+#include <minizinc/config.hh>
+#include <minizinc/file_utils.hh>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace MiniZinc {
+
+  namespace {
+
+    /// Format of dependency files
+    const unsigned int depsFormat = 3;
+
+    /// FNV-1a hash of \a n bytes starting at \a s, continuing from hash \a h
+    unsigned long long int fnv1a(const char* s, size_t n,
+                                 unsigned long long int h = 14695981039346656037ULL) {
+      for (size_t i=0; i<n; i++) {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 1099511628211ULL;
+      }
+      return h;
+    }
+
+    /// Hash of string \a s, continuing from hash \a h
+    unsigned long long int hashString(const std::string& s,
+                                      unsigned long long int h = 14695981039346656037ULL) {
+      // Include the length, so that concatenations of different strings differ
+      std::ostringstream oss;
+      oss << s.size() << ":";
+      h = fnv1a(oss.str().c_str(), oss.str().size(), h);
+      return fnv1a(s.c_str(), s.size(), h);
+    }
+
+    /// Collects the models and top-level declarations of a model
+    class ModelCollector : public ItemVisitor {
+    public:
+      /// All models, in the order they are visited
+      std::vector<Model*> models;
+      /// All top-level declarations
+      std::vector<VarDecl*> decls;
+      bool enterModel(Model* m) {
+        models.push_back(m);
+        return true;
+      }
+      void vVarDeclI(VarDeclI* i) {
+        decls.push_back(i->e());
+      }
+    };
+
+    /// Return hash of file \a filename (including its name)
+    unsigned long long int hashFile(const std::string& filename,
+                                    unsigned long long int h = 14695981039346656037ULL) {
+      h = hashString(filename, h);
+      std::ifstream is(filename.c_str(), std::ios::binary);
+      if (!is.is_open())
+        return hashString("", h);
+      std::string contents((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+      return hashString(contents, h);
+    }
+
+  }
+
+  Dependencies::Dependencies(void) : _sources(0) {}
+
+  void
+  Dependencies::compute(Model* m, const std::string& options) {
+    ModelCollector mc;
+    iterItems(mc, m);
+
+    _sources = hashString(std::string(MZN_VERSION_MAJOR)+"."+MZN_VERSION_MINOR+"."+MZN_VERSION_PATCH);
+    _sources = hashString(options, _sources);
+    for (unsigned int i=0; i<mc.models.size(); i++)
+      _sources = hashFile(mc.models[i]->filepath().str(), _sources);
+
+    _decls.resize(mc.decls.size());
+    for (unsigned int i=0; i<mc.decls.size(); i++) {
+      VarDecl* vd = mc.decls[i];
+      _decls[i].name = vd->id()->str().str();
+      _decls[i].hash = 0;
+      if (vd->e()) {
+        std::string s;
+        FdPrinter p(s, false);
+        p.print(vd->e());
+        p.flush();
+        _decls[i].hash = hashString(s);
+      }
+    }
+  }
+
+  void
+  Dependencies::outputs(const std::vector<std::string>& files) {
+    _outputs.resize(files.size());
+    for (unsigned int i=0; i<files.size(); i++) {
+      _outputs[i].name = files[i];
+      _outputs[i].hash = hashFile(files[i]);
+    }
+  }
+
+  bool
+  Dependencies::outputsUnchanged(void) const {
+    if (_outputs.empty())
+      return false;
+    for (unsigned int i=0; i<_outputs.size(); i++) {
+      if (!FileUtils::file_exists(_outputs[i].name) || hashFile(_outputs[i].name) != _outputs[i].hash)
+        return false;
+    }
+    return true;
+  }
+
+  bool
+  Dependencies::read(const std::string& filename) {
+    std::ifstream is(filename.c_str());
+    if (!is.is_open())
+      return false;
+    std::string magic;
+    unsigned int format;
+    std::string version;
+    if (!(is >> magic >> format >> version) || magic != "mzn-dependencies" || format != depsFormat ||
+        version != std::string(MZN_VERSION_MAJOR)+"."+MZN_VERSION_MINOR+"."+MZN_VERSION_PATCH)
+      return false;
+    std::vector<Decl> decls;
+    std::vector<Output> outputs;
+    unsigned long long int sources = 0;
+    std::string line;
+    std::getline(is, line);
+    while (std::getline(is, line)) {
+      std::istringstream iss(line);
+      std::string kind;
+      iss >> kind;
+      if (kind=="sources") {
+        if (!(iss >> std::hex >> sources))
+          return false;
+      } else if (kind=="decl") {
+        Decl d;
+        if (!(iss >> std::hex >> d.hash))
+          return false;
+        iss.get();
+        std::getline(iss, d.name);
+        decls.push_back(d);
+      } else if (kind=="output") {
+        Output o;
+        if (!(iss >> std::hex >> o.hash))
+          return false;
+        iss.get();
+        std::getline(iss, o.name);
+        outputs.push_back(o);
+      } else {
+        return false;
+      }
+    }
+    _sources = sources;
+    _decls = decls;
+    _outputs = outputs;
+    return true;
+  }
+
+  bool
+  Dependencies::write(const std::string& filename) const {
+    std::ofstream os(filename.c_str());
+    os << "mzn-dependencies " << depsFormat << " "
+       << MZN_VERSION_MAJOR << "." << MZN_VERSION_MINOR << "." << MZN_VERSION_PATCH << "\n";
+    os << "sources " << std::hex << std::setw(16) << std::setfill('0') << _sources << "\n";
+    for (unsigned int i=0; i<_decls.size(); i++)
+      os << "decl " << std::setw(16) << _decls[i].hash << " " << _decls[i].name << "\n";
+    for (unsigned int i=0; i<_outputs.size(); i++)
+      os << "output " << std::setw(16) << _outputs[i].hash << " " << _outputs[i].name << "\n";
+    os.close();
+    return os.good();
+  }
+
+  bool
+  Dependencies::unchanged(const Dependencies& d) const {
+    if (_sources != d._sources || _decls.size() != d._decls.size())
+      return false;
+    for (unsigned int i=0; i<_decls.size(); i++) {
+      if (_decls[i].hash != d._decls[i].hash || _decls[i].name != d._decls[i].name)
+        return false;
+    }
+    return true;
+  }
+
+  std::vector<std::string>
+  Dependencies::changed(const Dependencies& d) const {
+    UNORDERED_NAMESPACE::unordered_map<std::string,unsigned long long int> old;
+    for (unsigned int i=0; i<d._decls.size(); i++)
+      old[d._decls[i].name] = d._decls[i].hash;
+    std::vector<std::string> names;
+    for (unsigned int i=0; i<_decls.size(); i++) {
+      UNORDERED_NAMESPACE::unordered_map<std::string,unsigned long long int>::iterator it =
+        old.find(_decls[i].name);
+      if (it==old.end() || it->second != _decls[i].hash)
+        names.push_back(_decls[i].name);
+      if (it != old.end())
+        old.erase(it);
+    }
+    for (unsigned int i=0; i<d._decls.size(); i++) {
+      if (old.find(d._decls[i].name) != old.end())
+        names.push_back(d._decls[i].name);
+    }
+    return names;
+  }
+
+}
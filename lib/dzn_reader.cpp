@@ -0,0 +1,293 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/dzn_reader.hh>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace MiniZinc {
+
+  namespace {
+    bool isIdStart(char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+    bool isIdChar(char c) {
+      return isIdStart(c) || (c >= '0' && c <= '9') || c=='_';
+    }
+    bool isDigit(char c) {
+      return c >= '0' && c <= '9';
+    }
+  }
+
+  DznReader::DznReader(const char* begin, const char* end, const std::string& filename)
+  : _p(begin), _end(end), _filename(filename), _line(1) {}
+
+  void
+  DznReader::skip(void) {
+    while (_p < _end) {
+      switch (*_p) {
+        case '\n':
+          _line++;
+          // fall through
+        case ' ':
+        case '\t':
+        case '\r':
+          _p++;
+          break;
+        case '%':
+          while (_p < _end && *_p != '\n')
+            _p++;
+          break;
+        default:
+          return;
+      }
+    }
+  }
+
+  bool
+  DznReader::accept(char c) {
+    skip();
+    if (_p < _end && *_p==c) {
+      _p++;
+      return true;
+    }
+    return false;
+  }
+
+  bool
+  DznReader::acceptKeyword(const char* kw) {
+    skip();
+    size_t n = std::strlen(kw);
+    if (static_cast<size_t>(_end-_p) >= n && std::strncmp(_p, kw, n)==0 &&
+        (_p+n==_end || !isIdChar(_p[n]))) {
+      _p += n;
+      return true;
+    }
+    return false;
+  }
+
+  bool
+  DznReader::readNumber(IntVal& iv, FloatVal& fv, bool& isInt) {
+    skip();
+    const char* start = _p;
+    const char* p = _p;
+    bool neg = false;
+    if (p < _end && *p=='-') {
+      neg = true;
+      p++;
+    }
+    if (p==_end || !isDigit(*p))
+      return false;
+    if (*p=='0' && p+1 < _end && (p[1]=='x' || p[1]=='o'))
+      return false; // leave hexadecimal and octal literals to the parser
+    const char* digits = p;
+    while (p < _end && isDigit(*p))
+      p++;
+    isInt = true;
+    if (p+1 < _end && *p=='.' && isDigit(p[1])) {
+      isInt = false;
+      p++;
+      while (p < _end && isDigit(*p))
+        p++;
+    }
+    if (p < _end && (*p=='e' || *p=='E')) {
+      const char* q = p+1;
+      if (q < _end && (*q=='+' || *q=='-'))
+        q++;
+      if (q < _end && isDigit(*q)) {
+        isInt = false;
+        p = q;
+        while (p < _end && isDigit(*p))
+          p++;
+      }
+    }
+    if (p < _end && isIdChar(*p))
+      return false;
+    if (isInt) {
+      unsigned long long int v = 0;
+      // LLONG_MAX and LLONG_MIN encode the infinities, leave them to the parser
+      const unsigned long long int limit = static_cast<unsigned long long int>(LLONG_MAX-1);
+      for (const char* d = digits; d < p; d++) {
+        unsigned int digit = static_cast<unsigned int>(*d-'0');
+        if (v > (limit-digit)/10)
+          return false;
+        v = v*10+digit;
+      }
+      long long int sv = static_cast<long long int>(v);
+      iv = neg ? -sv : sv;
+    } else {
+      std::string num(start, p);
+      fv = std::strtod(num.c_str(), NULL);
+    }
+    _p = p;
+    return true;
+  }
+
+  bool
+  DznReader::readInt(IntVal& v) {
+    const char* start = _p;
+    FloatVal fv;
+    bool isInt;
+    if (!readNumber(v, fv, isInt))
+      return false;
+    if (!isInt) {
+      _p = start;
+      return false;
+    }
+    return true;
+  }
+
+  bool
+  DznReader::readRange(int& l, int& u) {
+    IntVal lv;
+    IntVal uv;
+    if (!readInt(lv) || !accept('.') || !accept('.') || !readInt(uv))
+      return false;
+    if (lv.toInt() < INT_MIN || lv.toInt() > INT_MAX || uv.toInt() < INT_MIN || uv.toInt() > INT_MAX)
+      return false;
+    l = static_cast<int>(lv.toInt());
+    u = static_cast<int>(uv.toInt());
+    return true;
+  }
+
+  Expression*
+  DznReader::readScalar(bool asFloat) {
+    skip();
+    if (_p==_end)
+      return NULL;
+    if (acceptKeyword("true"))
+      return constants().lit_true;
+    if (acceptKeyword("false"))
+      return constants().lit_false;
+    if (accept('{')) {
+      std::vector<IntVal> elems;
+      if (!accept('}')) {
+        do {
+          IntVal v;
+          if (!readInt(v))
+            return NULL;
+          elems.push_back(v);
+        } while (accept(','));
+        if (!accept('}'))
+          return NULL;
+      }
+      return new SetLit(_loc, IntSetVal::a(elems));
+    }
+    IntVal iv;
+    FloatVal fv;
+    bool isInt;
+    if (!readNumber(iv, fv, isInt))
+      return NULL;
+    if (isInt) {
+      skip();
+      if (_end-_p >= 2 && _p[0]=='.' && _p[1]=='.') {
+        _p += 2;
+        IntVal uv;
+        if (!readInt(uv))
+          return NULL;
+        return new SetLit(_loc, IntSetVal::a(iv,uv));
+      }
+      if (asFloat)
+        return FloatLit::a(static_cast<FloatVal>(iv.toInt()));
+      return IntLit::a(iv);
+    }
+    return FloatLit::a(fv);
+  }
+
+  bool
+  DznReader::done(void) {
+    skip();
+    return _p==_end;
+  }
+
+  bool
+  DznReader::readAssignmentId(std::string& id) {
+    skip();
+    const char* start = _p;
+    if (_p==_end || !isIdStart(*_p))
+      return false;
+    while (_p < _end && isIdChar(*_p))
+      _p++;
+    id.assign(start, _p);
+    return accept('=');
+  }
+
+  Expression*
+  DznReader::readLiteral(bool asFloat) {
+    GCLock lock;
+    skip();
+    // The file name is not rooted between calls, so create it afresh
+    if (!_filename.empty())
+      _loc.filename = ASTString(_filename);
+    _loc.first_line = _loc.last_line = _line;
+    std::vector<std::pair<int,int> > dims;
+    bool arrayNd = false;
+    if (static_cast<size_t>(_end-_p) > 6 && std::strncmp(_p, "array", 5)==0 &&
+        isDigit(_p[5])) {
+      const char* p = _p+5;
+      int n = 0;
+      while (p < _end && isDigit(*p)) {
+        n = n*10+(*p-'0');
+        p++;
+      }
+      if (p==_end || *p!='d' || n < 1 || n > 6)
+        return NULL;
+      _p = p+1;
+      if (!accept('('))
+        return NULL;
+      for (int i=0; i<n; i++) {
+        int l, u;
+        if (!readRange(l, u) || !accept(','))
+          return NULL;
+        dims.push_back(std::pair<int,int>(l,u));
+      }
+      arrayNd = true;
+    }
+    if (accept('[')) {
+      std::vector<Expression*> elems;
+      skip();
+      while (!accept(']')) {
+        Expression* e = readScalar(asFloat);
+        if (e==NULL)
+          return NULL;
+        elems.push_back(e);
+        if (!accept(',')) {
+          if (!accept(']'))
+            return NULL;
+          break;
+        }
+      }
+      if (arrayNd) {
+        if (!accept(')'))
+          return NULL;
+        long long int size = 1;
+        for (unsigned int i=0; i<dims.size(); i++)
+          size *= (dims[i].second >= dims[i].first) ? (dims[i].second-dims[i].first+1) : 0;
+        if (size != static_cast<long long int>(elems.size()))
+          return NULL;
+      } else {
+        dims.push_back(std::pair<int,int>(1,static_cast<int>(elems.size())));
+      }
+      return new ArrayLit(_loc, elems, dims);
+    }
+    if (arrayNd)
+      return NULL;
+    return readScalar(asFloat);
+  }
+
+  bool
+  DznReader::readAssignmentEnd(void) {
+    return accept(';') || done();
+  }
+
+}
@@ -214,6 +214,42 @@ namespace MiniZinc {
     }
   }
   
+  /// Check whether all elements of \a al are literals
+  bool isLiteralArray(ArrayLit* al) {
+    if (al->type().isbot() || al->type().bt()==Type::BT_TOP)
+      return false;
+    ASTExprVec<Expression> v = al->v();
+    for (unsigned int i=v.size(); i--;) {
+      switch (v[i]->eid()) {
+      case Expression::E_INTLIT:
+      case Expression::E_FLOATLIT:
+      case Expression::E_BOOLLIT:
+      case Expression::E_STRINGLIT:
+        break;
+      case Expression::E_SETLIT:
+        if (v[i]->cast<SetLit>()->isv()==NULL)
+          return false;
+        break;
+      default:
+        if (v[i] != constants().absent)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  /// Evaluate argument \a e of a call to a par function
+  Expression* eval_par_arg(EnvI& env, Expression* e) {
+    if (e->type().dim() > 0) {
+      // Bind arrays of literals directly instead of copying them
+      ArrayLit* al = eval_array_lit(env, e);
+      if (isLiteralArray(al))
+        return al;
+      return eval_par(env, al);
+    }
+    return eval_par(env, e);
+  }
+
   template<class Eval>
   typename Eval::Val eval_call(EnvI& env, Call* ce) {
     std::vector<Expression*> previousParameters(ce->decl()->params().size());
@@ -221,7 +257,7 @@ namespace MiniZinc {
       VarDecl* vd = ce->decl()->params()[i];
       previousParameters[i] = vd->e();
       vd->flat(vd);
-      vd->e(eval_par(env, ce->args()[i]));
+      vd->e(eval_par_arg(env, ce->args()[i]));
       if (vd->e()->type().ispar()) {
         if (Expression* dom = vd->ti()->domain()) {
           if (!dom->isa<TIId>()) {
@@ -482,32 +518,11 @@ namespace MiniZinc {
         if (lhs->type().isintset() && rhs->type().isintset()) {
           IntSetVal* v0 = eval_intset(env,lhs);
           IntSetVal* v1 = eval_intset(env,rhs);
-          IntSetRanges ir0(v0);
-          IntSetRanges ir1(v1);
           switch (bo->op()) {
-          case BOT_UNION:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
-          case BOT_DIFF:
-            {
-              Ranges::Diff<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
-          case BOT_SYMDIFF:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              Ranges::Inter<IntSetRanges,IntSetRanges> i(ir0,ir1);
-              Ranges::Diff<Ranges::Union<IntSetRanges,IntSetRanges>,
-                           Ranges::Inter<IntSetRanges,IntSetRanges>> sd(u,i);
-              return IntSetVal::ai(sd);
-            }
-          case BOT_INTERSECT:
-            {
-              Ranges::Inter<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+          case BOT_UNION: return IntSetVal::unite(v0,v1);
+          case BOT_DIFF: return IntSetVal::diff(v0,v1);
+          case BOT_SYMDIFF: return IntSetVal::symdiff(v0,v1);
+          case BOT_INTERSECT: return IntSetVal::intersect(v0,v1);
           default: throw EvalError(env, e->loc(),"not a set of int expression", bo->opToString());
           }
         } else if (lhs->type().isint() && rhs->type().isint()) {
@@ -819,32 +834,11 @@ namespace MiniZinc {
         if (lhs->type().isintset() && rhs->type().isintset()) {
           IntSetVal* v0 = eval_boolset(env,lhs);
           IntSetVal* v1 = eval_boolset(env,rhs);
-          IntSetRanges ir0(v0);
-          IntSetRanges ir1(v1);
           switch (bo->op()) {
-            case BOT_UNION:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
-            case BOT_DIFF:
-            {
-              Ranges::Diff<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
-            case BOT_SYMDIFF:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              Ranges::Inter<IntSetRanges,IntSetRanges> i(ir0,ir1);
-              Ranges::Diff<Ranges::Union<IntSetRanges,IntSetRanges>,
-              Ranges::Inter<IntSetRanges,IntSetRanges>> sd(u,i);
-              return IntSetVal::ai(sd);
-            }
-            case BOT_INTERSECT:
-            {
-              Ranges::Inter<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+            case BOT_UNION: return IntSetVal::unite(v0,v1);
+            case BOT_DIFF: return IntSetVal::diff(v0,v1);
+            case BOT_SYMDIFF: return IntSetVal::symdiff(v0,v1);
+            case BOT_INTERSECT: return IntSetVal::intersect(v0,v1);
             default: throw EvalError(env, e->loc(),"not a set of bool expression", bo->opToString());
           }
         } else if (lhs->type().isbool() && rhs->type().isbool()) {
@@ -2181,12 +2175,7 @@ namespace MiniZinc {
         switch (bo.op()) {
         case BOT_INTERSECT:
         case BOT_UNION:
-          {
-            IntSetRanges b0r(b0);
-            IntSetRanges b1r(b1);
-            Ranges::Union<IntSetRanges,IntSetRanges> u(b0r,b1r);
-            _bounds.push_back(IntSetVal::ai(u));
-          }
+          _bounds.push_back(IntSetVal::unite(b0,b1));
           break;
         case BOT_DIFF:
           {
@@ -2235,10 +2224,7 @@ namespace MiniZinc {
       if (valid && (c.id() == "set_intersect" || c.id() == "set_union")) {
         IntSetVal* b0 = _bounds.back(); _bounds.pop_back();
         IntSetVal* b1 = _bounds.back(); _bounds.pop_back();
-        IntSetRanges b0r(b0);
-        IntSetRanges b1r(b1);
-        Ranges::Union<IntSetRanges,IntSetRanges> u(b0r,b1r);
-        _bounds.push_back(IntSetVal::ai(u));
+        _bounds.push_back(IntSetVal::unite(b0,b1));
       } else if (valid && c.id() == "set_diff") {
         IntSetVal* b0 = _bounds.back(); _bounds.pop_back();
         _bounds.pop_back(); // don't need bounds of right hand side
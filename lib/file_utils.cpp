@@ -30,6 +30,16 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <fstream>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
 namespace MiniZinc { namespace FileUtils {
   
 #ifdef HAS_PIDPATH
@@ -128,4 +138,110 @@ namespace MiniZinc { namespace FileUtils {
 #endif
   }
   
+  SourceFile::SourceFile(void)
+    : _data(NULL), _scan(NULL), _size(0), _mapped(false), _open(false), _released(0) {}
+
+  SourceFile::~SourceFile(void) {
+    close();
+  }
+
+  void
+  SourceFile::close(void) {
+#ifndef _MSC_VER
+    if (_mapped) {
+      munmap(const_cast<char*>(_data), _size);
+      munmap(_scan, _size+2);
+    }
+#endif
+    _data = NULL;
+    _scan = NULL;
+    _size = 0;
+    _mapped = false;
+    _text.clear();
+    _open = false;
+    _released = 0;
+  }
+
+  void
+  SourceFile::assign(const std::string& text) {
+    close();
+    _text.reserve(text.size()+2);
+    _text = text;
+    _text.append(2, '\0');
+    _data = _text.data();
+    _scan = &_text[0];
+    _size = text.size();
+    _open = true;
+  }
+
+  void
+  SourceFile::release(size_t n) {
+#ifndef _MSC_VER
+    // Release whole pages, and only in large chunks to keep the number of
+    // system calls low
+    const size_t chunk = 1 << 20;
+    if (!_mapped || n > _size || n < _released+chunk)
+      return;
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    n -= n % pageSize;
+    madvise(const_cast<char*>(_data)+_released, n-_released, MADV_DONTNEED);
+    madvise(_scan+_released, n-_released, MADV_DONTNEED);
+    _released = n;
+#endif
+  }
+
+  bool
+  SourceFile::open(const std::string& filename) {
+    close();
+#ifndef _MSC_VER
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      ::close(fd);
+      return false;
+    }
+    if (st.st_size > 0) {
+      size_t n = static_cast<size_t>(st.st_size);
+      void* d = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+      // Reserve zero-filled memory for the contents and the two NUL bytes,
+      // and map the file over its beginning
+      void* s = d==MAP_FAILED ? MAP_FAILED :
+        mmap(NULL, n+2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (s != MAP_FAILED &&
+          mmap(s, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED) {
+        ::close(fd);
+        _data = static_cast<const char*>(d);
+        _scan = static_cast<char*>(s);
+        _size = n;
+        _mapped = true;
+        _open = true;
+        return true;
+      }
+      if (s != MAP_FAILED)
+        munmap(s, n+2);
+      if (d != MAP_FAILED)
+        munmap(d, n);
+    }
+    ::close(fd);
+#endif
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    if (!is.is_open())
+      return false;
+    is.seekg(0, std::ios::end);
+    size_t n = static_cast<size_t>(is.tellg());
+    is.seekg(0, std::ios::beg);
+    _text.resize(n+2);
+    if (!is.read(&_text[0], n)) {
+      _text.clear();
+      return false;
+    }
+    _data = _text.data();
+    _scan = &_text[0];
+    _size = n;
+    _open = true;
+    return true;
+  }
+
 }}
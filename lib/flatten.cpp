@@ -20,6 +20,7 @@
 #include <minizinc/stl_map_set.hh>
 
 #include <minizinc/flatten_internal.hh>
+#include <minizinc/profiler.hh>
 
 namespace MiniZinc {
 
@@ -168,7 +169,7 @@ namespace MiniZinc {
 
 #define MZN_FILL_REIFY_MAP(T,ID) reifyMap.insert(std::pair<ASTString,ASTString>(constants().ids.T.ID,constants().ids.T ## reif.ID));
 
-  EnvI::EnvI(Model* orig0) : orig(orig0), output(new Model), ignorePartial(false), maxCallStack(0), collect_vardecls(false), in_redundant_constraint(0), _flat(new Model), ids(0) {
+  EnvI::EnvI(Model* orig0) : orig(orig0), output(new Model), vo(true), ignorePartial(false), maxCallStack(0), collect_vardecls(false), in_redundant_constraint(0), profiler(NULL), map_hits(0), _flat(new Model), ids(0) {
     MZN_FILL_REIFY_MAP(int_,lin_eq);
     MZN_FILL_REIFY_MAP(int_,lin_le);
     MZN_FILL_REIFY_MAP(int_,lin_ne);
@@ -212,12 +213,10 @@ namespace MiniZinc {
       return ids++;
     }
   void EnvI::map_insert(Expression* e, const EE& ee) {
-      KeepAlive ka(e);
-      map.insert(ka,WW(ee.r(),ee.b()));
+      map.insert(e,WW(ee.r(),ee.b()));
     }
   EnvI::Map::iterator EnvI::map_find(Expression* e) {
-    KeepAlive ka(e);
-    Map::iterator it = map.find(ka);
+    Map::iterator it = map.find(e);
     if (it != map.end()) {
       if (it->second.r()) {
         if (it->second.r()->isa<VarDecl>()) {
@@ -228,16 +227,22 @@ namespace MiniZinc {
       } else {
         return map.end();
       }
+      map_hits++;
     }
     return it;
   }
   void EnvI::map_remove(Expression* e) {
-    KeepAlive ka(e);
-    map.remove(ka);
+    map.remove(e);
   }
   EnvI::Map::iterator EnvI::map_end(void) {
     return map.end();
   }
+  unsigned long long int EnvI::map_lookups(void) const {
+    return map.lookups();
+  }
+  unsigned long long int EnvI::map_hitcount(void) const {
+    return map_hits;
+  }
   void EnvI::dump(void) {
     struct EED {
       static std::string d(const WW& ee) {
@@ -250,6 +255,8 @@ namespace MiniZinc {
   }
   
   void EnvI::flat_addItem(Item* i) {
+    if (profiler)
+      profiler->addItem(i);
     _flat->addItem(i);
     Expression* toAnnotate = NULL;
     Expression* toAdd = NULL;
@@ -558,6 +565,14 @@ namespace MiniZinc {
   unsigned int Env::maxCallStack(void) const {
     return envi().maxCallStack;
   }
+
+  unsigned long long int Env::cseLookups(void) const {
+    return envi().map_lookups();
+  }
+
+  unsigned long long int Env::cseHits(void) const {
+    return envi().map_hitcount();
+  }
   
   bool isTotal(FunctionI* fi) {
     return fi->ann().contains(constants().ann.promise_total);
@@ -924,10 +939,7 @@ namespace MiniZinc {
                 while (id != NULL) {
                   if (id->decl()->ti()->domain()) {
                     IntSetVal* domain = eval_intset(env,id->decl()->ti()->domain());
-                    IntSetRanges dr(domain);
-                    IntSetRanges ibr(ibv);
-                    Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                    IntSetVal* newibv = IntSetVal::ai(i);
+                    IntSetVal* newibv = IntSetVal::intersect(domain,ibv);
                     if (ibv->card() == newibv->card()) {
                       id->decl()->ti()->setComputedDomain(true);
                     } else {
@@ -1023,10 +1035,7 @@ namespace MiniZinc {
                         vdi->ti()->domain(vd->ti()->domain());
                       } else {
                         IntSetVal* vdi_dom = eval_intset(env, vdi->ti()->domain());
-                        IntSetRanges isvr(isv);
-                        IntSetRanges vdi_domr(vdi_dom);
-                        Ranges::Inter<IntSetRanges, IntSetRanges> inter(isvr,vdi_domr);
-                        IntSetVal* newdom = IntSetVal::ai(inter);
+                        IntSetVal* newdom = IntSetVal::intersect(isv,vdi_dom);
                         if (newdom->size()==0) {
                           env.flat()->fail(env);
                         } else {
@@ -1120,10 +1129,7 @@ namespace MiniZinc {
               if (ibv) {
                 if (vd->ti()->domain()) {
                   IntSetVal* domain = eval_intset(env,vd->ti()->domain());
-                  IntSetRanges dr(domain);
-                  IntSetRanges ibr(ibv);
-                  Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                  IntSetVal* newibv = IntSetVal::ai(i);
+                  IntSetVal* newibv = IntSetVal::intersect(domain,ibv);
                   if (ibv->card() == newibv->card()) {
                     vd->ti()->setComputedDomain(true);
                   } else {
@@ -1903,18 +1909,12 @@ namespace MiniZinc {
       if (isv_else) {
         IntSetVal* isv = isv_else;
         for (unsigned int i=0; i<r_bounds_set.size(); i++) {
-          IntSetRanges i0(isv);
-          IntSetRanges i1(r_bounds_set[i]);
-          Ranges::Union<IntSetRanges, IntSetRanges> u(i0,i1);
-          isv = IntSetVal::ai(u);
+          isv = IntSetVal::unite(isv,r_bounds_set[i]);
         }
         if (r) {
           IntSetVal* orig_r_bounds = compute_intset_bounds(env,r->id());
           if (orig_r_bounds) {
-            IntSetRanges i0(isv);
-            IntSetRanges i1(orig_r_bounds);
-            Ranges::Inter<IntSetRanges, IntSetRanges> inter(i0,i1);
-            isv = IntSetVal::ai(inter);
+            isv = IntSetVal::intersect(isv,orig_r_bounds);
           }
         }
         SetLit* r_dom = new SetLit(Location().introduce(),isv);
@@ -4044,10 +4044,7 @@ namespace MiniZinc {
                   bool changeDom = false;
                   if (id->decl()->ti()->domain()) {
                     IntSetVal* domain = eval_intset(env,id->decl()->ti()->domain());
-                    IntSetRanges dr(domain);
-                    IntSetRanges ibr(newdom);
-                    Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                    IntSetVal* newibv = IntSetVal::ai(i);
+                    IntSetVal* newibv = IntSetVal::intersect(domain,newdom);
                     if (domain->card() != newibv->card()) {
                       newdom = newibv;
                       changeDom = true;
@@ -4288,6 +4285,7 @@ namespace MiniZinc {
     case Expression::E_CALL:
       {
         Call* c = e->cast<Call>();
+        ProfileScope ps(env.profiler, c->loc(), c->id());
         FunctionI* decl = env.orig->matchFn(env,c);
         if (decl == NULL) {
           throw InternalError("undeclared function or predicate "
@@ -5054,9 +5052,9 @@ namespace MiniZinc {
         VarDecl* reallyFlat = vd->flat();
         while (reallyFlat != NULL && reallyFlat != reallyFlat->flat())
           reallyFlat = reallyFlat->flat();
-        IdMap<int>::iterator idx = reallyFlat ? env.output_vo.idx.find(reallyFlat->id()) : env.output_vo.idx.end();
-        IdMap<int>::iterator idx2 = env.output_vo.idx.find(vd->id());
-        if (idx==env.output_vo.idx.end() && idx2==env.output_vo.idx.end()) {
+        int idx = reallyFlat ? env.output_vo.find(reallyFlat) : -1;
+        int idx2 = env.output_vo.find(vd);
+        if (idx==-1 && idx2==-1) {
           VarDeclI* nvi = new VarDeclI(Location().introduce(), copy(env,env.cmap,vd)->cast<VarDecl>());
           Type t = nvi->e()->ti()->type();
           if (t.ti() != Type::TI_PAR) {
@@ -5225,9 +5223,9 @@ namespace MiniZinc {
                 removeIsOutput(reallyFlat);
                 
                 if (e.vo.occurrences(reallyFlat)==0 && reallyFlat->e()==NULL) {
-                  IdMap<int>::iterator cur_idx = e.vo.idx.find(reallyFlat->id());
-                  if (cur_idx != e.vo.idx.end()) {
-                    VarDeclI* vdi = (*e.flat())[cur_idx->second]->cast<VarDeclI>();
+                  int cur_idx = e.vo.find(reallyFlat);
+                  if (cur_idx != -1) {
+                    VarDeclI* vdi = (*e.flat())[cur_idx]->cast<VarDeclI>();
                     vdi->remove();
                   }
                   
@@ -5415,8 +5413,8 @@ namespace MiniZinc {
         EnvI& env;
         OV2(EnvI& env0) : env(env0) {}
         void vVarDeclI(VarDeclI* vdi) {
-          IdMap<int>::iterator idx = env.output_vo.idx.find(vdi->e()->id());
-          if (idx!=env.output_vo.idx.end())
+          int idx = env.output_vo.find(vdi->e());
+          if (idx!=-1)
             return;
           if (Expression* vd_e = env.cmap.find(vdi->e())) {
             VarDecl* vd = vd_e->cast<VarDecl>();
@@ -5550,9 +5548,9 @@ namespace MiniZinc {
     while (!deletedVarDecls.empty()) {
       VarDecl* cur = deletedVarDecls.back(); deletedVarDecls.pop_back();
       if (e.output_vo.occurrences(cur) == 0) {
-        IdMap<int>::iterator cur_idx = e.output_vo.idx.find(cur->id());
-        if (cur_idx != e.output_vo.idx.end()) {
-          VarDeclI* vdi = (*e.output)[cur_idx->second]->cast<VarDeclI>();
+        int cur_idx = e.output_vo.find(cur);
+        if (cur_idx != -1) {
+          VarDeclI* vdi = (*e.output)[cur_idx]->cast<VarDeclI>();
           if (!vdi->removed()) {
             CollectDecls cd(e.output_vo,deletedVarDecls,vdi);
             topDown(cd,cur->e());
@@ -5565,19 +5563,7 @@ namespace MiniZinc {
       }
     }
 
-    for (IdMap<VarOccurrences::Items>::iterator it = e.output_vo._m.begin();
-         it != e.output_vo._m.end(); ++it) {
-      std::vector<Item*> toRemove;
-      for (VarOccurrences::Items::iterator iit = it->second.begin();
-           iit != it->second.end(); ++iit) {
-        if ((*iit)->removed()) {
-          toRemove.push_back(*iit);
-        }
-      }
-      for (unsigned int i=0; i<toRemove.size(); i++) {
-        it->second.erase(toRemove[i]);
-      }
-    }
+    e.output_vo.compact();
   }
   
   void cleanupOutput(EnvI& env) {
@@ -5614,6 +5600,7 @@ namespace MiniZinc {
   
   void flatten(Env& e, FlatteningOptions opt) {
     EnvI& env = e.envi();
+    env.profiler = opt.profiler;
 
     bool onlyRangeDomains;
     {
@@ -5648,6 +5635,7 @@ namespace MiniZinc {
         return !(i->isa<ConstraintI>()  && env.flat()->failed());
       }
       void vVarDeclI(VarDeclI* v) {
+        ProfileScope ps(env.profiler, v->loc());
         if (v->e()->type().isvar() || v->e()->type().isann()) {
           (void) flat_exp(env,Ctx(),v->e()->id(),NULL,constants().var_true);
         } else {
@@ -5685,12 +5673,14 @@ namespace MiniZinc {
         }
       }
       void vConstraintI(ConstraintI* ci) {
+        ProfileScope ps(env.profiler, ci->loc());
         (void) flat_exp(env,Ctx(),ci->e(),constants().var_true,constants().var_true);
       }
       void vSolveI(SolveI* si) {
         if (hadSolveItem)
           throw FlatteningError(env,si->loc(), "Only one solve item allowed");
         hadSolveItem = true;
+        ProfileScope ps(env.profiler, si->loc());
         GCLock lock;
         SolveI* nsi = NULL;
         switch (si->st()) {
@@ -6139,11 +6129,11 @@ namespace MiniZinc {
     while (!deletedVarDecls.empty()) {
       VarDecl* cur = deletedVarDecls.back(); deletedVarDecls.pop_back();
       if (env.vo.occurrences(cur) == 0 && !isOutput(cur)) {
-        IdMap<int>::iterator cur_idx = env.vo.idx.find(cur->id());
-        if (cur_idx != env.vo.idx.end() && !m[cur_idx->second]->removed()) {
-          CollectDecls cd(env.vo,deletedVarDecls,m[cur_idx->second]->cast<VarDeclI>());
+        int cur_idx = env.vo.find(cur);
+        if (cur_idx != -1 && !m[cur_idx]->removed()) {
+          CollectDecls cd(env.vo,deletedVarDecls,m[cur_idx]->cast<VarDeclI>());
           topDown(cd,cur->e());
-          env.flat_removeItem(cur_idx->second);
+          env.flat_removeItem(cur_idx);
         }
       }
     }
@@ -6504,19 +6494,7 @@ namespace MiniZinc {
     m->compact();
     e.envi().output->compact();
 
-    for (IdMap<VarOccurrences::Items>::iterator it = env.vo._m.begin();
-         it != env.vo._m.end(); ++it) {
-      std::vector<Item*> toRemove;
-      for (VarOccurrences::Items::iterator iit = it->second.begin();
-           iit != it->second.end(); ++iit) {
-        if ((*iit)->removed()) {
-          toRemove.push_back(*iit);
-        }
-      }
-      for (unsigned int i=0; i<toRemove.size(); i++) {
-        it->second.erase(toRemove[i]);
-      }
-    }
+    env.vo.compact();
 
     class Cmp {
     public:
@@ -6584,6 +6562,7 @@ namespace MiniZinc {
           }
         } else if (ConstraintI* ci = (*flat)[i]->dyn_cast<ConstraintI>()) {
           if (Call* call = ci->e()->dyn_cast<Call>()) {
+            stats.n_pred_ct[call->id().str()]++;
             if (call->args().size() > 0) {
               Type all_t;
               for (unsigned int i=0; i<call->args().size(); i++) {
@@ -9,11 +9,20 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <minizinc/config.hh>
+
+// Include before the MiniZinc headers, since SafeInt may redefine nullptr
+#ifdef HAS_STD_THREAD
+#include <thread>
+#include <mutex>
+#include <atomic>
+#endif
+
 #include <minizinc/gc.hh>
 #include <minizinc/ast.hh>
 #include <minizinc/hash.hh>
 #include <minizinc/model.hh>
-#include <minizinc/config.hh>
+#include <minizinc/timer.hh>
 
 #include <vector>
 #include <cstring>
@@ -64,6 +73,26 @@ namespace MiniZinc {
     FreeListNode(size_t s) : ASTNode(ASTNode::NID_FL), next(NULL), size(s) {}
   };
 
+  bool ASTNode::_parallelMark = false;
+
+  bool
+  ASTNode::atomicMark(const ASTNode* n) {
+#ifdef HAS_STD_THREAD
+    static_assert(sizeof(std::atomic<unsigned char>)==sizeof(unsigned char),
+                  "marks require lock-free atomic bytes");
+    std::atomic<unsigned char>* m =
+      reinterpret_cast<std::atomic<unsigned char>*>(&n->_gc_mark);
+    // Only write marks that are not set yet
+    if (m->load(std::memory_order_relaxed) != 0)
+      return false;
+    return m->exchange(1, std::memory_order_relaxed) == 0;
+#else
+    bool unmarked = n->_gc_mark==0;
+    n->_gc_mark = 1;
+    return unmarked;
+#endif
+  }
+
   class HeapPage {
   public:
     HeapPage* next;
@@ -89,22 +118,47 @@ namespace MiniZinc {
     std::map<int,GCStat> gc_stats;
 #endif
   protected:
+    /// Pages for small and medium objects (allocation continues on the first)
     HeapPage* _page;
+    /// Pages holding a single large object each
+    HeapPage* _large;
+    /// Pages of dead large objects, kept for reuse
+    HeapPage* _large_free;
+    /// Memory in pages kept for reuse by large objects
+    size_t _large_free_mem;
     Model* _rootset;
     KeepAlive* _roots;
     WeakRef* _weakRefs;
-    static const int _max_fl = 5;
+
+    /// Size of the smallest free list node
+    static const size_t _fl_min = (sizeof(FreeListNode)+7) & ~static_cast<size_t>(7);
+    /// Size of the largest block kept in a size class
+    static const size_t _fl_max = 512;
+    /// Index of the largest size class
+    static const int _max_fl = static_cast<int>((_fl_max-_fl_min)/8);
+    /// Free lists for each size class (multiples of 8 bytes up to \a _fl_max)
     FreeListNode* _fl[_max_fl+1];
-    static const size_t _fl_size[_max_fl+1];
-    int _fl_slot(size_t _size) {
-      size_t size = _size;
-      assert(size <= _fl_size[_max_fl]);
-      assert(size >= _fl_size[0]);
-      size -= sizeof(Item);
-      assert(size % sizeof(void*) == 0);
-      size /= sizeof(void*);
-      assert(size >= 1);
-      int slot = static_cast<int>(size)-1;
+    /// Bit set of non-empty size classes
+    unsigned long long int _fl_used;
+    /// Number of free lists for blocks larger than \a _fl_max
+    static const int _max_flb = 12;
+    /// Free lists for blocks larger than \a _fl_max, by power of two
+    FreeListNode* _flb[_max_flb+1];
+    /// Objects of at least this size are allocated on their own page
+    static const size_t _large_min = 1<<16;
+    /// Maximum amount of memory kept for reuse by large objects
+    static const size_t _large_cache = 1<<23;
+    int _fl_slot(size_t size) {
+      assert(size <= _fl_max);
+      assert(size >= _fl_min);
+      assert(size % 8 == 0);
+      return static_cast<int>((size-_fl_min)/8);
+    }
+    int _flb_slot(size_t size) {
+      assert(size > _fl_max);
+      int slot = 0;
+      for (size_t s = size/(2*_fl_max); s > 0 && slot < _max_flb; s /= 2)
+        slot++;
       return slot;
     }
 
@@ -117,6 +171,34 @@ namespace MiniZinc {
     /// High water mark of all allocated memory
     size_t _max_alloced_mem;
 
+    /// Collector mode
+    GC::Mode _mode;
+    /// Total number of bytes allocated
+    unsigned long long int _total_alloced;
+    /// Number of threads used for marking
+    unsigned int _mark_threads;
+    /// Time spent in the mark phase of each collection (in milliseconds)
+    std::vector<double> _mark_times;
+    /// Stack of expressions that remain to be marked
+    std::vector<const Expression*> _mark_stack;
+    /// Pages that have not been swept since the last incremental collection
+    HeapPage* _unswept;
+    /// Number of garbage collections
+    unsigned int _collections;
+    /// Total time spent in collector pauses (in milliseconds)
+    double _pause_time;
+    /// Longest collector pause (in milliseconds)
+    double _max_pause_time;
+
+    /// Interned strings
+    InternTable _strings;
+    /// Interned integer literals
+    InternTable _intLits;
+    /// Interned float literals
+    InternTable _floatLits;
+    /// Interned integer set values
+    InternTable _intSets;
+
     /// A trail item
     struct TItem {
       Expression** l;
@@ -130,23 +212,31 @@ namespace MiniZinc {
 
     Heap(void)
       : _page(NULL)
+      , _large(NULL)
+      , _large_free(NULL)
+      , _large_free_mem(0)
       , _rootset(NULL)
       , _roots(NULL)
       , _weakRefs(NULL)
       , _alloced_mem(0)
       , _free_mem(0)
       , _gc_threshold(10)
-      , _max_alloced_mem(0) {
-      for (int i=_max_fl+1; i--;)
-        _fl[i] = NULL;
+      , _max_alloced_mem(0)
+      , _mode(GC::GCM_FULL)
+      , _total_alloced(0)
+      , _mark_threads(1)
+      , _unswept(NULL)
+      , _collections(0)
+      , _pause_time(0.0)
+      , _max_pause_time(0.0) {
+      clearFreeLists();
     }
 
     /// Default size of pages to allocate
     static const size_t pageSize = 1<<20;
-    
-    HeapPage* allocPage(size_t s, bool exact=false) {
-      if (!exact)
-        s = std::max(s,pageSize);
+
+    HeapPage* allocPage(size_t s) {
+      s = std::max(s,pageSize);
       HeapPage* newPage =
         static_cast<HeapPage*>(::malloc(sizeof(HeapPage)+s-1));
 #ifndef NDEBUG
@@ -155,40 +245,32 @@ namespace MiniZinc {
       _alloced_mem += s;
       _max_alloced_mem = std::max(_max_alloced_mem, _alloced_mem);
       _free_mem += s;
-      if (exact && _page) {
-        new (newPage) HeapPage(_page->next,s);
-        _page->next = newPage;
-      } else {
-        if (_page) {
-          size_t ns = _page->size-_page->used;
-          assert(ns <= _fl_size[_max_fl]);
-          if (ns >= _fl_size[0]) {
-            // Remainder of page can be added to free lists
-            FreeListNode* fln = 
-              reinterpret_cast<FreeListNode*>(_page->data+_page->used);
-            _page->used += ns;
-            new (fln) FreeListNode(ns, _fl[_fl_slot(ns)]);
-            _fl[_fl_slot(ns)] = fln;
-          } else {
-            // Waste a little memory (less than smallest free list slot)
-            _free_mem -= ns;
-            assert(_alloced_mem >= _free_mem);
-          }
+      if (_page) {
+        size_t ns = _page->size-_page->used;
+        if (ns >= _fl_min) {
+          // Remainder of page can be added to free lists
+          _page->used += ns;
+          addFree(_page->data+_page->used-ns, ns);
+        } else {
+          // Waste a little memory (less than smallest free list slot)
+          _free_mem -= ns;
+          assert(_alloced_mem >= _free_mem);
         }
-        new (newPage) HeapPage(_page,s);
-        _page = newPage;
       }
+      new (newPage) HeapPage(_page,s);
+      _page = newPage;
       return newPage;
     }
 
+    /// Allocate \a size bytes at the end of the current page
     void*
-    alloc(size_t size, bool exact=false) {
-      assert(size<=80 || exact);
+    alloc(size_t size) {
+      assert(size < _large_min);
       /// Align to word boundary
       size += ((8 - (size & 7)) & 7);
       HeapPage* p = _page;
-      if (exact || _page==NULL || _page->used+size >= _page->size)
-        p = allocPage(size,exact);
+      if (_page==NULL || _page->used+size >= _page->size)
+        p = allocPage(size);
       char* ret = p->data+p->used;
       p->used += size;
       _free_mem -= size;
@@ -204,20 +286,142 @@ namespace MiniZinc {
     template<typename T>
     T* alloc(int n) { return static_cast<T*>(alloc(n*sizeof(T))); }
 
+    /// Remove all blocks from the free lists
+    void clearFreeLists(void) {
+      for (int i=_max_fl+1; i--;)
+        _fl[i] = NULL;
+      _fl_used = 0;
+      for (int i=_max_flb+1; i--;)
+        _flb[i] = NULL;
+    }
+
+    /// Add block of \a size bytes at \a b to the free lists
+    void addFree(char* b, size_t size) {
+      assert(size >= _fl_min);
+      FreeListNode* fln = reinterpret_cast<FreeListNode*>(b);
+      if (size <= _fl_max) {
+        int slot = _fl_slot(size);
+        new (fln) FreeListNode(size, _fl[slot]);
+        _fl[slot] = fln;
+        _fl_used |= 1ULL << slot;
+      } else {
+        int slot = _flb_slot(size);
+        new (fln) FreeListNode(size, _flb[slot]);
+        _flb[slot] = fln;
+      }
+    }
+
+    /// Return first \a size bytes of free block \a b, putting the rest back on the free lists
+    void* split(FreeListNode* b, size_t size) {
+      if (b->size > size)
+        addFree(reinterpret_cast<char*>(b)+size, b->size-size);
+      return b;
+    }
+
+    /// Find a free block of \a size bytes, or return NULL
+    void* findFree(size_t size) {
+      if (size <= _fl_max) {
+        int slot = _fl_slot(size);
+        if (_fl[slot]) {
+          FreeListNode* p = _fl[slot];
+          _fl[slot] = p->next;
+          if (_fl[slot]==NULL)
+            _fl_used &= ~(1ULL << slot);
+          return p;
+        }
+        // Split a block from a larger size class, leaving a usable remainder
+        if (size+_fl_min <= _fl_max) {
+          int first = _fl_slot(size+_fl_min);
+          unsigned long long int used = _fl_used >> first;
+          for (int i=first; used != 0; i++, used >>= 1) {
+            if (used & 1) {
+              FreeListNode* p = _fl[i];
+              _fl[i] = p->next;
+              if (_fl[i]==NULL)
+                _fl_used &= ~(1ULL << i);
+              return split(p, size);
+            }
+          }
+        }
+      }
+      // First fit among the larger blocks
+      for (int i = size > _fl_max ? _flb_slot(size) : 0; i <= _max_flb; i++) {
+        for (FreeListNode** p = &_flb[i]; *p != NULL; p = &(*p)->next) {
+          if ((*p)->size==size || (*p)->size >= size+_fl_min) {
+            FreeListNode* b = *p;
+            *p = b->next;
+            return split(b, size);
+          }
+        }
+      }
+      return NULL;
+    }
+
+    /// Allocate \a size bytes, using the free lists if possible
     void* fl(size_t size) {
-      int slot = _fl_slot(size);
-      assert(slot <= _max_fl);
-      if (_fl[slot]) {
-        FreeListNode* p = _fl[slot];
-        _fl[slot] = p->next;
+      void* ret = findFree(size);
+      if (ret==NULL && _unswept) {
+        // Sweep pages left over from the last collection until
+        // the free lists can satisfy the request
+        Timer pause;
+        while (_unswept && ret==NULL) {
+          sweepStep();
+          ret = findFree(size);
+        }
+        pauseDone(pause.ms());
+      }
+      if (ret) {
         _free_mem -= size;
-        return p;
+        return ret;
       }
       return alloc(size);
     }
 
+    /// Allocate large object of \a size bytes on its own page
+    void* allocLarge(size_t size) {
+      HeapPage* p = NULL;
+      // Reuse a page that is not much larger than required
+      for (HeapPage** pp = &_large_free; *pp != NULL; pp = &(*pp)->next) {
+        if ((*pp)->size >= size && (*pp)->size <= 2*size) {
+          p = *pp;
+          *pp = p->next;
+          _large_free_mem -= p->size;
+          _free_mem -= p->size;
+          break;
+        }
+      }
+      if (p==NULL) {
+        p = static_cast<HeapPage*>(::malloc(sizeof(HeapPage)+size-1));
+#ifndef NDEBUG
+        memset(p,255,sizeof(HeapPage)+size-1);
+#endif
+        _alloced_mem += size;
+        _max_alloced_mem = std::max(_max_alloced_mem, _alloced_mem);
+        new (p) HeapPage(NULL,size);
+      }
+      p->used = size;
+      p->next = _large;
+      _large = p;
+      return p->data;
+    }
+
+    void pauseDone(double ms) {
+      _pause_time += ms;
+      _max_pause_time = std::max(_max_pause_time, ms);
+    }
+
     void rungc(void) {
       if (_alloced_mem > _gc_threshold) {
+        Timer pause;
+        if (_unswept) {
+          // Complete the previous collection first
+          while (_unswept)
+            sweepStep();
+          if (_alloced_mem <= _gc_threshold) {
+            pauseDone(pause.ms());
+            return;
+          }
+        }
 #ifdef MINIZINC_GC_STATS
         std::cerr << "GC\n\talloced " << (_alloced_mem/1024) << "\n\tfree " << (_free_mem/1024) << "\n\tdiff "
                   << ((_alloced_mem-_free_mem)/1024)
@@ -225,8 +429,15 @@ namespace MiniZinc {
                   << "\n";
 #endif
         mark();
-        sweep();
-        _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
+        if (_mode==GC::GCM_INCREMENTAL) {
+          _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
+          startSweep();
+        } else {
+          sweep();
+          _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
+        }
+        _collections++;
+        pauseDone(pause.ms());
 #ifdef MINIZINC_GC_STATS
         std::cerr << "done\n\talloced " << (_alloced_mem/1024) << "\n\tfree " << (_free_mem/1024) << "\n\tdiff "
                   << ((_alloced_mem-_free_mem)/1024)
@@ -235,8 +446,51 @@ namespace MiniZinc {
 #endif
       }
     }
+    /// Collect the entire heap and release all cached large object pages
+    void collect(void) {
+      Timer pause;
+      while (_unswept)
+        sweepStep();
+      mark();
+      sweep();
+      while (_large_free) {
+        HeapPage* p = _large_free;
+        _large_free = p->next;
+        _large_free_mem -= p->size;
+        _free_mem -= p->size;
+        freePage(p);
+      }
+      _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
+      _collections++;
+      pauseDone(pause.ms());
+    }
     void mark(void);
+    /// Mark all expressions on the mark stack and reachable from them
+    void markStack(void);
+#ifdef HAS_STD_THREAD
+    class ParallelMarker;
+#endif
     void sweep(void);
+    /// Release resources held by unreachable node \a n
+    void finalize(ASTNode* n);
+    /// Sweep pages of large objects
+    void sweepLarge(void);
+    /// Remove unmarked nodes from interning table \a t
+    void sweepInterned(InternTable& t);
+    /// Remove unmarked nodes from all interning tables
+    void sweepInterned(void);
+    /// Sweep page \a p, return whether it is empty and can be released if \a release
+    bool sweepPage(HeapPage* p, bool release);
+    /// Return page \a p to the system
+    void freePage(HeapPage* p);
+    /// Return empty page \a p, all of whose used memory is free, to the system
+    void freeEmptyPage(HeapPage* p);
+    /// Start sweeping after an incremental collection
+    void startSweep(void);
+    /// Sweep the next unswept page
+    void sweepStep(void);
+    /// Sweep all remaining unswept pages
+    void finishSweep(void);
 
     static size_t
     nodesize(ASTNode* n) {
@@ -344,15 +598,10 @@ namespace MiniZinc {
 
   const size_t GC::Heap::pageSize;
 
-  const size_t
-  GC::Heap::_fl_size[GC::Heap::_max_fl+1] = {
-    sizeof(Item)+1*sizeof(void*),
-    sizeof(Item)+2*sizeof(void*),
-    sizeof(Item)+3*sizeof(void*),
-    sizeof(Item)+4*sizeof(void*),
-    sizeof(Item)+5*sizeof(void*),
-    sizeof(Item)+6*sizeof(void*),
-  };
+  const size_t GC::Heap::_fl_min;
+  const size_t GC::Heap::_fl_max;
+  const size_t GC::Heap::_large_min;
+  const size_t GC::Heap::_large_cache;
 
   GC::GC(void) : _heap(new Heap()), _lock_count(0) {}
 
@@ -385,9 +634,11 @@ namespace MiniZinc {
   void*
   GC::alloc(size_t size) {
     assert(locked());
+    size += ((8 - (size & 7)) & 7);
+    _heap->_total_alloced += size;
     void* ret;
-    if (size < _heap->_fl_size[0] || size > _heap->_fl_size[_heap->_max_fl]) {
-      ret = _heap->alloc(size,true);
+    if (size >= Heap::_large_min) {
+      ret = _heap->allocLarge(size);
     } else {
       ret = _heap->fl(size);
     }
@@ -401,10 +652,12 @@ namespace MiniZinc {
     std::cerr << "================= mark =================: ";
     gc_stats.clear();
 #endif
+    Timer markTime;
+    _mark_stack.clear();
 
     for (KeepAlive* e = _roots; e != NULL; e = e->next()) {
       if ((*e)() && (*e)()->_gc_mark==0) {
-        Expression::mark((*e)());
+        _mark_stack.push_back((*e)());
 #if defined(MINIZINC_GC_STATS)
         gc_stats[(*e)()->_id].keepalive++;
 #endif
@@ -415,8 +668,11 @@ namespace MiniZinc {
 #endif
     
     Model* m = _rootset;
-    if (m==NULL)
+    if (m==NULL) {
+      markStack();
+      _mark_times.push_back(markTime.ms());
       return;
+    }
     do {
       m->_filepath.mark();
       m->_filename.mark();
@@ -430,18 +686,18 @@ namespace MiniZinc {
             i->cast<IncludeI>()->f().mark();
             break;
           case Item::II_VD:
-            Expression::mark(i->cast<VarDeclI>()->e());
+            _mark_stack.push_back(i->cast<VarDeclI>()->e());
 #if defined(MINIZINC_GC_STATS)
             gc_stats[i->cast<VarDeclI>()->e()->Expression::eid()].inmodel++;
 #endif
             break;
           case Item::II_ASN:
             i->cast<AssignI>()->id().mark();
-            Expression::mark(i->cast<AssignI>()->e());
-            Expression::mark(i->cast<AssignI>()->decl());
+            _mark_stack.push_back(i->cast<AssignI>()->e());
+            _mark_stack.push_back(i->cast<AssignI>()->decl());
             break;
           case Item::II_CON:
-            Expression::mark(i->cast<ConstraintI>()->e());
+            _mark_stack.push_back(i->cast<ConstraintI>()->e());
 #if defined(MINIZINC_GC_STATS)
             gc_stats[i->cast<ConstraintI>()->e()->Expression::eid()].inmodel++;
 #endif
@@ -450,26 +706,26 @@ namespace MiniZinc {
             {
               SolveI* si = i->cast<SolveI>();
               for (ExpressionSetIter it = si->ann().begin(); it != si->ann().end(); ++it) {
-                Expression::mark(*it);
+                _mark_stack.push_back(*it);
               }
             }
-            Expression::mark(i->cast<SolveI>()->e());
+            _mark_stack.push_back(i->cast<SolveI>()->e());
             break;
           case Item::II_OUT:
-            Expression::mark(i->cast<OutputI>()->e());
+            _mark_stack.push_back(i->cast<OutputI>()->e());
             break;
           case Item::II_FUN:
             {
               FunctionI* fi = i->cast<FunctionI>();
               fi->id().mark();
-              Expression::mark(fi->ti());
+              _mark_stack.push_back(fi->ti());
               for (ExpressionSetIter it = fi->ann().begin(); it != fi->ann().end(); ++it) {
-                Expression::mark(*it);
+                _mark_stack.push_back(*it);
               }
-              Expression::mark(fi->e());
+              _mark_stack.push_back(fi->e());
               fi->params().mark();
               for (unsigned int k=0; k<fi->params().size(); k++) {
-                Expression::mark(fi->params()[k]);
+                _mark_stack.push_back(fi->params()[k]);
               }
             }
             break;      
@@ -480,8 +736,10 @@ namespace MiniZinc {
     } while (m != _rootset);
     
     for (unsigned int i=trail.size(); i--;) {
-      Expression::mark(trail[i].v);
+      _mark_stack.push_back(trail[i].v);
     }
+
+    markStack();
     
     bool fixPrev = false;
     for (WeakRef* wr = _weakRefs; wr != NULL; wr = wr->next()) {
@@ -499,86 +757,305 @@ namespace MiniZinc {
       }
     }
 
+    _mark_times.push_back(markTime.ms());
 #if defined(MINIZINC_GC_STATS)
     std::cerr << "+";
     std::cerr << "\n";
 #endif
   }
-    
+
+#ifdef HAS_STD_THREAD
+  /**
+   * \brief Marking of expressions by several threads
+   *
+   * Each thread marks from its own stack. When other threads are idle,
+   * a thread moves part of its stack to a shared stack, from which idle
+   * threads steal. Marking ends when all threads are idle.
+   *
+   * All marks, including those of strings, vectors and other leaf nodes,
+   * are set atomically while the threads run, since several threads may
+   * reach the same node. A mark is a byte of its own, so setting it does
+   * not race with other threads reading the bit-fields of the node.
+   */
+  class GC::Heap::ParallelMarker {
+  protected:
+    /// State of a marking thread
+    struct Worker {
+      /// Expressions that remain to be marked by this thread
+      std::vector<const Expression*> stack;
+      /// Expressions that other threads can steal
+      std::vector<const Expression*> shared;
+      /// Size of \a shared
+      std::atomic<size_t> nShared;
+      /// Mutex protecting \a shared
+      std::mutex m;
+      /// Constructor
+      Worker(void) : nShared(0) {}
+    };
+    /// The threads
+    std::vector<Worker*> _w;
+    /// Number of threads that have run out of work
+    std::atomic<unsigned int> _idle;
+    /// Move part of the stack of \a w to its shared stack
+    void share(Worker& w) {
+      size_t n = std::min(w.stack.size()/2, static_cast<size_t>(4096));
+      std::lock_guard<std::mutex> lock(w.m);
+      w.shared.insert(w.shared.end(), w.stack.end()-n, w.stack.end());
+      w.stack.resize(w.stack.size()-n);
+      w.nShared = w.shared.size();
+    }
+    /// Move a shared stack to the empty stack of thread \a i, return whether successful
+    bool steal(unsigned int i) {
+      for (unsigned int k=0; k<_w.size(); k++) {
+        Worker& v = *_w[(i+k) % _w.size()];
+        if (v.nShared > 0) {
+          std::lock_guard<std::mutex> lock(v.m);
+          if (!v.shared.empty()) {
+            _w[i]->stack.swap(v.shared);
+            v.nShared = 0;
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+    /// Return whether any thread has shared work
+    bool hasShared(void) {
+      for (unsigned int k=0; k<_w.size(); k++)
+        if (_w[k]->nShared > 0)
+          return true;
+      return false;
+    }
+    /// Run thread \a i until all threads are idle
+    void run(unsigned int i) {
+      Worker& w = *_w[i];
+      for (;;) {
+        while (!w.stack.empty()) {
+          const Expression* e = w.stack.back();
+          w.stack.pop_back();
+          if (e != NULL && ASTNode::atomicMark(e))
+            Expression::markChildren(e, w.stack);
+          if (w.stack.size() > 64 && _idle > 0 && w.nShared==0)
+            share(w);
+        }
+        if (!steal(i)) {
+          // Only threads with work can share it, so no work is left
+          // once all threads are idle
+          _idle++;
+          for (;;) {
+            if (_idle == _w.size())
+              return;
+            if (hasShared()) {
+              _idle--;
+              break;
+            }
+            std::this_thread::yield();
+          }
+        }
+      }
+    }
+  public:
+    /// Constructor for \a n threads
+    ParallelMarker(unsigned int n) : _idle(0) {
+      for (unsigned int i=0; i<n; i++)
+        _w.push_back(new Worker());
+    }
+    /// Destructor
+    ~ParallelMarker(void) {
+      for (unsigned int i=0; i<_w.size(); i++)
+        delete _w[i];
+    }
+    /// Mark expressions reachable from \a roots
+    void mark(const std::vector<const Expression*>& roots) {
+      for (unsigned int i=0; i<roots.size(); i++)
+        _w[i % _w.size()]->stack.push_back(roots[i]);
+      // Thread creation and join order the flag with the helpers' accesses
+      ASTNode::_parallelMark = true;
+      std::vector<std::thread> helpers;
+      for (unsigned int i=1; i<_w.size(); i++)
+        helpers.push_back(std::thread(&ParallelMarker::run, this, i));
+      run(0);
+      for (unsigned int i=0; i<helpers.size(); i++)
+        helpers[i].join();
+      ASTNode::_parallelMark = false;
+    }
+  };
+#endif
+
   void
-  GC::Heap::sweep(void) {
-#if defined(MINIZINC_GC_STATS)
-    std::cerr << "=============== GC sweep =============\n";
+  GC::Heap::markStack(void) {
+#ifdef HAS_STD_THREAD
+    if (_mark_threads > 1) {
+      ParallelMarker pm(_mark_threads);
+      pm.mark(_mark_stack);
+      _mark_stack.clear();
+      return;
+    }
 #endif
-    HeapPage* p = _page;
-    HeapPage* prev = NULL;
-    while (p) {
-      size_t off = 0;
-      bool wholepage = false;
-      while (off < p->used) {
-        ASTNode* n = reinterpret_cast<ASTNode*>(p->data+off);
-        size_t ns = nodesize(n);
-        assert(ns != 0);
+    while (!_mark_stack.empty()) {
+      const Expression* e = _mark_stack.back();
+      _mark_stack.pop_back();
+      if (e != NULL && e->_gc_mark==0) {
+        e->_gc_mark = 1;
+        Expression::markChildren(e, _mark_stack);
+      }
+    }
+  }
+
+  void
+  GC::Heap::sweepInterned(InternTable& t) {
+    size_t n = 0;
+    for (unsigned int i=0; i<t._e.size(); i++) {
+      if (t._e[i].n != NULL && t._e[i].n->_gc_mark==1)
+        n++;
+    }
+    if (n==t._n)
+      return;
+    size_t cap = t._e.size();
+    while (cap > 1024 && n*8 < cap)
+      cap /= 2;
+    std::vector<InternTable::Entry> old(cap);
+    old.swap(t._e);
+    t._n = 0;
+    for (unsigned int i=0; i<old.size(); i++) {
+      if (old[i].n != NULL && old[i].n->_gc_mark==1)
+        t.insert(old[i].n, old[i].h);
+    }
+  }
+
+  void
+  GC::Heap::sweepInterned(void) {
+    // Unreachable nodes are removed before any memory is swept,
+    // so that they cannot be returned from a table afterwards
+    sweepInterned(_strings);
+    sweepInterned(_intLits);
+    sweepInterned(_floatLits);
+    sweepInterned(_intSets);
+  }
+
+  void
+  GC::Heap::finalize(ASTNode* n) {
+    switch (n->_id) {
+      case Item::II_FUN:
+        static_cast<FunctionI*>(n)->ann().~Annotation();
+        break;
+      case Item::II_SOL:
+        static_cast<SolveI*>(n)->ann().~Annotation();
+        break;
+      case Expression::E_VARDECL:
+        // Reset WeakRef inside VarDecl
+        static_cast<VarDecl*>(n)->flat(NULL);
+        // fall through
+      default:
+        if (n->_id >= ASTNode::NID_END+1 && n->_id <= Expression::EID_END) {
+          static_cast<Expression*>(n)->ann().~Annotation();
+        }
+    }
+  }
+
+  bool
+  GC::Heap::sweepPage(HeapPage* p, bool release) {
+    size_t off = 0;
+    // Start of the current run of free memory, coalesced into one block
+    size_t freeStart = 0;
+    bool inFree = false;
+    while (off < p->used) {
+      ASTNode* n = reinterpret_cast<ASTNode*>(p->data+off);
+      size_t ns = nodesize(n);
+      assert(ns != 0);
 #if defined(MINIZINC_GC_STATS)
-        GCStat& stats = gc_stats[n->_id];
-        stats.first++;
-        stats.total += ns;
+      GCStat& stats = gc_stats[n->_id];
+      stats.first++;
+      stats.total += ns;
 #endif
-        if (n->_gc_mark==0) {
-          switch (n->_id) {
-            case Item::II_FUN:
-              static_cast<FunctionI*>(n)->ann().~Annotation();
-              break;
-            case Item::II_SOL:
-              static_cast<SolveI*>(n)->ann().~Annotation();
-              break;
-            case Expression::E_VARDECL:
-              // Reset WeakRef inside VarDecl
-              static_cast<VarDecl*>(n)->flat(NULL);
-              // fall through
-            default:
-              if (n->_id >= ASTNode::NID_END+1 && n->_id <= Expression::EID_END) {
-                static_cast<Expression*>(n)->ann().~Annotation();
-              }
-          }
-          if (ns >= _fl_size[0] && ns <= _fl_size[_max_fl]) {
-            FreeListNode* fln = static_cast<FreeListNode*>(n);
-            new (fln) FreeListNode(ns, _fl[_fl_slot(ns)]);
-            _fl[_fl_slot(ns)] = fln;
-            _free_mem += ns;
+      if (n->_id == ASTNode::NID_FL || n->_gc_mark==0) {
+        if (n->_id != ASTNode::NID_FL) {
+          finalize(n);
+          _free_mem += ns;
+          assert(_alloced_mem >= _free_mem);
+        }
+        if (!inFree) {
+          inFree = true;
+          freeStart = off;
+        }
+      } else {
 #if defined(MINIZINC_GC_STATS)
-            gc_stats[fln->_id].second++;
+        stats.second++;
 #endif
-            assert(_alloced_mem >= _free_mem);
-          } else {
-            assert(off==0);
-            assert(p->used==p->size);
-            wholepage = true;
-          }
+        n->_gc_mark=0;
+        if (inFree) {
+          addFree(p->data+freeStart, off-freeStart);
+          inFree = false;
+        }
+      }
+      off += ns;
+    }
+    if (inFree) {
+      if (freeStart==0 && release)
+        return true;
+      addFree(p->data+freeStart, off-freeStart);
+    }
+    return false;
+  }
+
+  void
+  GC::Heap::sweepLarge(void) {
+    HeapPage** pp = &_large;
+    while (*pp != NULL) {
+      HeapPage* p = *pp;
+      ASTNode* n = reinterpret_cast<ASTNode*>(p->data);
+      if (n->_gc_mark==0) {
+        finalize(n);
+        *pp = p->next;
+        if (_large_free_mem+p->size <= _large_cache) {
+          p->next = _large_free;
+          _large_free = p;
+          _large_free_mem += p->size;
+          _free_mem += p->size;
         } else {
-#if defined(MINIZINC_GC_STATS)
-          stats.second++;
-#endif
-          if (n->_id != ASTNode::NID_FL)
-            n->_gc_mark=0;
+          freePage(p);
         }
-        off += ns;
+      } else {
+        n->_gc_mark=0;
+        pp = &p->next;
       }
-      if (wholepage) {
+    }
+  }
+
+  void
+  GC::Heap::freePage(HeapPage* p) {
 #ifndef NDEBUG
-        memset(p->data,42,p->size);
+    memset(p->data,42,p->size);
 #endif
-        if (prev) {
-          prev->next = p->next;
-        } else {
-          assert(p==_page);
-          _page = p->next;
-        }
+    _alloced_mem -= p->size;
+    assert(_alloced_mem >= _free_mem);
+    ::free(p);
+  }
+
+  void
+  GC::Heap::freeEmptyPage(HeapPage* p) {
+    _free_mem -= p->used;
+    freePage(p);
+  }
+
+  void
+  GC::Heap::sweep(void) {
+#if defined(MINIZINC_GC_STATS)
+    std::cerr << "=============== GC sweep =============\n";
+#endif
+    sweepInterned();
+    // Free lists are rebuilt, coalescing adjacent free blocks
+    clearFreeLists();
+    sweepLarge();
+    HeapPage* p = _page;
+    HeapPage* prev = NULL;
+    while (p) {
+      if (sweepPage(p,p!=_page)) {
+        assert(prev != NULL);
+        prev->next = p->next;
         HeapPage* pf = p;
         p = p->next;
-        _alloced_mem -= pf->size;
-        assert(_alloced_mem >= _free_mem);
-        ::free(pf);
+        freeEmptyPage(pf);
       } else {
         prev = p;
         p = p->next;
@@ -602,6 +1079,52 @@ namespace MiniZinc {
 #endif
   }
 
+  void
+  GC::Heap::startSweep(void) {
+    // All free lists are rebuilt by sweeping, so that no object
+    // can be allocated on a page that has not been swept yet
+    sweepInterned();
+    clearFreeLists();
+    sweepLarge();
+    if (_page) {
+      // The current page is swept immediately, since allocation
+      // continues on it
+      _unswept = _page->next;
+      _page->next = NULL;
+      sweepPage(_page,false);
+    }
+    if (_unswept==NULL)
+      _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
+  }
+
+  void
+  GC::Heap::sweepStep(void) {
+    assert(_unswept);
+    HeapPage* p = _unswept;
+    _unswept = p->next;
+    if (sweepPage(p,true)) {
+      freeEmptyPage(p);
+    } else if (_page) {
+      p->next = _page->next;
+      _page->next = p;
+    } else {
+      p->next = NULL;
+      _page = p;
+    }
+    if (_unswept==NULL)
+      _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
+  }
+
+  void
+  GC::Heap::finishSweep(void) {
+    if (_unswept) {
+      Timer pause;
+      while (_unswept)
+        sweepStep();
+      pauseDone(pause.ms());
+    }
+  }
+
   ASTVec::ASTVec(size_t size)
     : ASTNode(NID_VEC), _size(size) {}
   void*
@@ -620,6 +1143,13 @@ namespace MiniZinc {
     return GC::gc()->alloc(s);
   }
 
+  void
+  GC::collect(void) {
+    GC* gc = GC::gc();
+    assert(!gc->locked());
+    gc->_heap->collect();
+  }
+
   void
   GC::mark(void) {
     GC* gc = GC::gc();
@@ -646,7 +1176,162 @@ namespace MiniZinc {
     GC* gc = GC::gc();
     return gc->_heap->_max_alloced_mem;
   }
-  
+  size_t
+  GC::usedMem(void) {
+    GC* gc = GC::gc();
+    return gc->_heap->_alloced_mem - gc->_heap->_free_mem;
+  }
+  void
+  GC::mode(GC::Mode m) {
+    if (gc()==NULL) {
+      gc() = new GC();
+    }
+    GC* gc = GC::gc();
+    if (m==GCM_FULL)
+      gc->_heap->finishSweep();
+    gc->_heap->_mode = m;
+  }
+  GC::Mode
+  GC::mode(void) {
+    GC* gc = GC::gc();
+    return gc==NULL ? GCM_FULL : gc->_heap->_mode;
+  }
+  void
+  GC::markThreads(unsigned int n) {
+    if (gc()==NULL) {
+      gc() = new GC();
+    }
+    gc()->_heap->_mark_threads = std::max(1u, n);
+  }
+  unsigned int
+  GC::markThreads(void) {
+    GC* gc = GC::gc();
+    return gc==NULL ? 1 : gc->_heap->_mark_threads;
+  }
+  const std::vector<double>&
+  GC::markTimes(void) {
+    GC* gc = GC::gc();
+    return gc->_heap->_mark_times;
+  }
+  unsigned long long int
+  GC::allocated(void) {
+    GC* gc = GC::gc();
+    return gc==NULL ? 0 : gc->_heap->_total_alloced;
+  }
+  unsigned int
+  GC::collections(void) {
+    GC* gc = GC::gc();
+    return gc->_heap->_collections;
+  }
+  double
+  GC::pauseTime(void) {
+    GC* gc = GC::gc();
+    return gc->_heap->_pause_time;
+  }
+  double
+  GC::maxPauseTime(void) {
+    GC* gc = GC::gc();
+    return gc->_heap->_max_pause_time;
+  }
+  InternTable&
+  GC::strings(void) {
+    return GC::gc()->_heap->_strings;
+  }
+  InternTable&
+  GC::intLits(void) {
+    return GC::gc()->_heap->_intLits;
+  }
+  InternTable&
+  GC::floatLits(void) {
+    return GC::gc()->_heap->_floatLits;
+  }
+  InternTable&
+  GC::intSets(void) {
+    return GC::gc()->_heap->_intSets;
+  }
+  size_t
+  GC::internedStrings(void) {
+    return GC::gc()->_heap->_strings.size();
+  }
+  size_t
+  GC::internedStringMem(void) {
+    const InternTable& t = GC::gc()->_heap->_strings;
+    size_t mem = t.memsize();
+    for (unsigned int i=0; i<t._e.size(); i++) {
+      if (t._e[i].n != NULL)
+        mem += static_cast<ASTStringO*>(t._e[i].n)->memsize();
+    }
+    return mem;
+  }
+
+  unsigned int
+  GC::pages(void) {
+    GC* gc = GC::gc();
+    unsigned int n = 0;
+    for (HeapPage* p = gc->_heap->_page; p != NULL; p = p->next)
+      n++;
+    for (HeapPage* p = gc->_heap->_unswept; p != NULL; p = p->next)
+      n++;
+    return n;
+  }
+  unsigned int
+  GC::largePages(void) {
+    GC* gc = GC::gc();
+    unsigned int n = 0;
+    for (HeapPage* p = gc->_heap->_large; p != NULL; p = p->next)
+      n++;
+    return n;
+  }
+  unsigned int
+  GC::cachedLargePages(void) {
+    GC* gc = GC::gc();
+    unsigned int n = 0;
+    for (HeapPage* p = gc->_heap->_large_free; p != NULL; p = p->next)
+      n++;
+    return n;
+  }
+  double
+  GC::fragmentation(void) {
+    Heap* heap = GC::gc()->_heap;
+    size_t total = 0;
+    for (HeapPage* p = heap->_page; p != NULL; p = p->next)
+      total += p->size;
+    for (HeapPage* p = heap->_unswept; p != NULL; p = p->next)
+      total += p->size;
+    size_t free = 0;
+    for (int i=Heap::_max_fl+1; i--;)
+      for (FreeListNode* f = heap->_fl[i]; f != NULL; f = f->next)
+        free += f->size;
+    for (int i=Heap::_max_flb+1; i--;)
+      for (FreeListNode* f = heap->_flb[i]; f != NULL; f = f->next)
+        free += f->size;
+    return total==0 ? 0.0 : static_cast<double>(free)/total;
+  }
+
+  void
+  InternTable::insert(ASTNode* n, size_t h) {
+    size_t mask = _e.size()-1;
+    size_t i = h & mask;
+    while (_e[i].n != NULL)
+      i = (i+1) & mask;
+    _e[i].n = n;
+    _e[i].h = h;
+    _n++;
+  }
+
+  void
+  InternTable::add(ASTNode* n, size_t h) {
+    if ((_n+1)*2 > _e.size()) {
+      std::vector<Entry> old(std::max(static_cast<size_t>(1024), _e.size()*2));
+      old.swap(_e);
+      _n = 0;
+      for (unsigned int i=0; i<old.size(); i++) {
+        if (old[i].n != NULL)
+          insert(old[i].n, old[i].h);
+      }
+    }
+    insert(n, h);
+  }
 
   void*
   ASTNode::operator new(size_t size) {
@@ -18,7 +18,8 @@
 
 namespace MiniZinc {
   
-  Model::Model(void) : _parent(NULL), _solveItem(NULL), _outputItem(NULL), _failed(false) {
+  Model::Model(void) : _fnCacheEnabled(false), _fnCacheHits(0), _fnCacheMisses(0),
+    _parent(NULL), _solveItem(NULL), _outputItem(NULL), _failed(false) {
     GC::add(this);
   }
 
@@ -67,6 +68,8 @@ namespace MiniZinc {
     Model* m = this;
     while (m->_parent)
       m = m->_parent;
+    m->_fnCache.clear();
+    m->_fnCacheEnabled = false;
     FnMap::iterator i_id = m->fnmap.find(fi->id());
     if (i_id == m->fnmap.end()) {
       // new element
@@ -101,6 +104,125 @@ namespace MiniZinc {
     }
   }
 
+  size_t
+  Model::FnCacheHash::operator()(const FnCacheKey& k) const {
+    size_t h = reinterpret_cast<size_t>(k.first);
+    for (unsigned int i=0; i<k.second.size(); i++)
+      h ^= static_cast<size_t>(k.second[i]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
+
+  namespace {
+    /// Return cache key component for type \a t
+    int typeKey(const Type& t) {
+      return (t.toInt() << 1) | (t.cv() ? 1 : 0);
+    }
+    /// Return cache key component for the type of \a e
+    int typeKey(const Expression* e) {
+      return typeKey(e->type());
+    }
+
+    /// Return first function in \a v whose parameters match types \a t
+    FunctionI* matchFnTypes(const std::vector<FunctionI*>& v, const std::vector<Type>& t) {
+      for (unsigned int i=0; i<v.size(); i++) {
+        FunctionI* fi = v[i];
+#ifdef MZN_DEBUG_FUNCTION_REGISTRY
+        std::cerr << "try " << *fi;
+#endif
+        if (fi->params().size() == t.size()) {
+          bool match=true;
+          for (unsigned int j=0; j<t.size(); j++) {
+            if (!t[j].isSubtypeOf(fi->params()[j]->type())) {
+#ifdef MZN_DEBUG_FUNCTION_REGISTRY
+              std::cerr << t[j].toString() << " does not match "
+              << fi->params()[j]->type().toString() << "\n";
+#endif
+              match=false;
+              break;
+            }
+          }
+          if (match) {
+            return fi;
+          }
+        }
+      }
+      return NULL;
+    }
+
+    /// Return function in \a v matching arguments \a args
+    template<class Args>
+    FunctionI* matchFnArgs(EnvI& env, const std::vector<FunctionI*>& v, const Args& args) {
+      std::vector<FunctionI*> matched;
+      const Expression* botarg = NULL;
+      for (unsigned int i=0; i<v.size(); i++) {
+        FunctionI* fi = v[i];
+#ifdef MZN_DEBUG_FUNCTION_REGISTRY
+        std::cerr << "try " << *fi;
+#endif
+        if (fi->params().size() == args.size()) {
+          bool match=true;
+          for (unsigned int j=0; j<args.size(); j++) {
+            if (!args[j]->type().isSubtypeOf(fi->params()[j]->type())) {
+#ifdef MZN_DEBUG_FUNCTION_REGISTRY
+              std::cerr << args[j]->type().toString() << " does not match "
+              << fi->params()[j]->type().toString() << "\n";
+              std::cerr << "Wrong argument is " << *args[j];
+#endif
+              match=false;
+              break;
+            }
+            if (args[j]->type().isbot() && fi->params()[j]->type().bt()!=Type::BT_TOP) {
+              botarg = args[j];
+            }
+          }
+          if (match) {
+            if (botarg)
+              matched.push_back(fi);
+            else
+              return fi;
+          }
+        }
+      }
+      if (matched.empty())
+        return NULL;
+      if (matched.size()==1)
+        return matched[0];
+      Type t = matched[0]->ti()->type();
+      t.ti(Type::TI_PAR);
+      for (unsigned int i=1; i<matched.size(); i++) {
+        if (!t.isSubtypeOf(matched[i]->ti()->type()))
+          throw TypeError(env, botarg->loc(), "ambiguous overloading on return type of function");
+      }
+      return matched[0];
+    }
+  }
+
+  template<class Args>
+  inline void
+  Model::fnCacheKey(const std::vector<FunctionI*>* v, int kind, const Args& args) const {
+    _fnCacheKey.first = v;
+    _fnCacheKey.second.resize(args.size()+1);
+    _fnCacheKey.second[0] = kind;
+    for (unsigned int i=0; i<args.size(); i++)
+      _fnCacheKey.second[i+1] = typeKey(args[i]);
+  }
+
+  unsigned long long int
+  Model::fnCacheHits(void) const {
+    const Model* m = this;
+    while (m->_parent)
+      m = m->_parent;
+    return m->_fnCacheHits;
+  }
+
+  unsigned long long int
+  Model::fnCacheMisses(void) const {
+    const Model* m = this;
+    while (m->_parent)
+      m = m->_parent;
+    return m->_fnCacheMisses;
+  }
+
   FunctionI*
   Model::matchFn(EnvI& env, const ASTString& id,
                  const std::vector<Type>& t) {
@@ -113,30 +235,20 @@ namespace MiniZinc {
     if (i_id == m->fnmap.end()) {
       return NULL;
     }
-    std::vector<FunctionI*>& v = i_id->second;
-    for (unsigned int i=0; i<v.size(); i++) {
-      FunctionI* fi = v[i];
-#ifdef MZN_DEBUG_FUNCTION_REGISTRY
-      std::cerr << "try " << *fi;
-#endif
-      if (fi->params().size() == t.size()) {
-        bool match=true;
-        for (unsigned int j=0; j<t.size(); j++) {
-          if (!t[j].isSubtypeOf(fi->params()[j]->type())) {
-#ifdef MZN_DEBUG_FUNCTION_REGISTRY
-            std::cerr << t[j].toString() << " does not match "
-            << fi->params()[j]->type().toString() << "\n";
-#endif
-            match=false;
-            break;
-          }
-        }
-        if (match) {
-          return fi;
-        }
+    const std::vector<FunctionI*>& v = i_id->second;
+    if (m->_fnCacheEnabled) {
+      m->fnCacheKey(&v, 0, t);
+      FnCache::const_iterator c_it = m->_fnCache.find(m->_fnCacheKey);
+      if (c_it != m->_fnCache.end()) {
+        m->_fnCacheHits++;
+        return c_it->second;
       }
     }
-    return NULL;
+    m->_fnCacheMisses++;
+    FunctionI* fi = matchFnTypes(v,t);
+    if (m->_fnCacheEnabled)
+      m->_fnCache.insert(std::make_pair(m->_fnCacheKey,fi));
+    return fi;
   }
 
   namespace {
@@ -167,6 +279,9 @@ namespace MiniZinc {
     for (FnMap::iterator it=m->fnmap.begin(); it!=m->fnmap.end(); ++it) {
       std::sort(it->second.begin(),it->second.end(),funsort);
     }
+    // Parameter types are final once functions are sorted
+    m->_fnCache.clear();
+    m->_fnCacheEnabled = true;
   }
 
   FunctionI*
@@ -182,47 +297,19 @@ namespace MiniZinc {
       return NULL;
     }
     const std::vector<FunctionI*>& v = it->second;
-    std::vector<FunctionI*> matched;
-    Expression* botarg = NULL;
-    for (unsigned int i=0; i<v.size(); i++) {
-      FunctionI* fi = v[i];
-#ifdef MZN_DEBUG_FUNCTION_REGISTRY
-      std::cerr << "try " << *fi;
-#endif
-      if (fi->params().size() == args.size()) {
-        bool match=true;
-        for (unsigned int j=0; j<args.size(); j++) {
-          if (!args[j]->type().isSubtypeOf(fi->params()[j]->type())) {
-#ifdef MZN_DEBUG_FUNCTION_REGISTRY
-            std::cerr << args[j]->type().toString() << " does not match "
-            << fi->params()[j]->type().toString() << "\n";
-#endif
-            match=false;
-            break;
-          }
-          if (args[j]->type().isbot() && fi->params()[j]->type().bt()!=Type::BT_TOP) {
-            botarg = args[j];
-          }
-        }
-        if (match) {
-          if (botarg)
-            matched.push_back(fi);
-          else
-            return fi;
-        }
+    if (m->_fnCacheEnabled) {
+      m->fnCacheKey(&v, 1, args);
+      FnCache::const_iterator c_it = m->_fnCache.find(m->_fnCacheKey);
+      if (c_it != m->_fnCache.end()) {
+        m->_fnCacheHits++;
+        return c_it->second;
       }
     }
-    if (matched.empty())
-      return NULL;
-    if (matched.size()==1)
-      return matched[0];
-    Type t = matched[0]->ti()->type();
-    t.ti(Type::TI_PAR);
-    for (unsigned int i=1; i<matched.size(); i++) {
-      if (!t.isSubtypeOf(matched[i]->ti()->type()))
-        throw TypeError(env, botarg->loc(), "ambiguous overloading on return type of function");
-    }
-    return matched[0];
+    m->_fnCacheMisses++;
+    FunctionI* fi = matchFnArgs(env,v,args);
+    if (m->_fnCacheEnabled)
+      m->_fnCache.insert(std::make_pair(m->_fnCacheKey,fi));
+    return fi;
   }
   
   FunctionI*
@@ -237,48 +324,19 @@ namespace MiniZinc {
       return NULL;
     }
     const std::vector<FunctionI*>& v = it->second;
-    std::vector<FunctionI*> matched;
-    Expression* botarg = NULL;
-    for (unsigned int i=0; i<v.size(); i++) {
-      FunctionI* fi = v[i];
-#ifdef MZN_DEBUG_FUNCTION_REGISTRY
-      std::cerr << "try " << *fi;
-#endif
-      if (fi->params().size() == c->args().size()) {
-        bool match=true;
-        for (unsigned int j=0; j<c->args().size(); j++) {
-          if (!c->args()[j]->type().isSubtypeOf(fi->params()[j]->type())) {
-#ifdef MZN_DEBUG_FUNCTION_REGISTRY
-            std::cerr << c->args()[j]->type().toString() << " does not match "
-            << fi->params()[j]->type().toString() << "\n";
-            std::cerr << "Wrong argument is " << *c->args()[j];
-#endif
-            match=false;
-            break;
-          }
-          if (c->args()[j]->type().isbot() && fi->params()[j]->type().bt()!=Type::BT_TOP) {
-            botarg = c->args()[j];
-          }
-        }
-        if (match) {
-          if (botarg)
-            matched.push_back(fi);
-          else
-            return fi;
-        }
+    if (m->_fnCacheEnabled) {
+      m->fnCacheKey(&v, 1, c->args());
+      FnCache::const_iterator c_it = m->_fnCache.find(m->_fnCacheKey);
+      if (c_it != m->_fnCache.end()) {
+        m->_fnCacheHits++;
+        return c_it->second;
       }
     }
-    if (matched.empty())
-      return NULL;
-    if (matched.size()==1)
-      return matched[0];
-    Type t = matched[0]->ti()->type();
-    t.ti(Type::TI_PAR);
-    for (unsigned int i=1; i<matched.size(); i++) {
-      if (!t.isSubtypeOf(matched[i]->ti()->type()))
-        throw TypeError(env, botarg->loc(), "ambiguous overloading on return type of function");
-    }
-    return matched[0];
+    m->_fnCacheMisses++;
+    FunctionI* fi = matchFnArgs(env,v,c->args());
+    if (m->_fnCacheEnabled)
+      m->_fnCache.insert(std::make_pair(m->_fnCacheKey,fi));
+    return fi;
   }
 
   Item*&
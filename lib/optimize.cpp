@@ -19,43 +19,238 @@
 #include <minizinc/optimize_constraints.hh>
 
 #include <vector>
+#include <algorithm>
 
 namespace MiniZinc {
 
+  namespace {
+    /// Hash of item \a i in record \a r
+    inline size_t occHash(unsigned int r, Item* i) {
+      size_t h = (reinterpret_cast<size_t>(i) >> 4) * 31 + r;
+      h ^= h >> 15;
+      h *= 0x2c1b3c6d;
+      h ^= h >> 12;
+      return h;
+    }
+  }
+
+  VarOccurrences::VarOccurrences(bool declIdx)
+    : _declIdx(declIdx), _garbage(0), _occLive(0), _occUsed(0) {}
+
+  int VarOccurrences::record(VarDecl* vd) {
+    if (_declIdx) {
+      int r = vd->occIdx();
+      return (r >= 0 && r < static_cast<int>(_vars.size()) && _vars[r].vd==vd) ? r : -1;
+    }
+    IdMap<int>::iterator it = _byName.find(vd->id());
+    return it==_byName.end() ? -1 : it->second;
+  }
+
+  int VarOccurrences::addRecord(VarDecl* vd) {
+    int r = record(vd);
+    if (r == -1) {
+      r = static_cast<int>(_vars.size());
+      Var v;
+      v.vd = vd;
+      v.idx = -1;
+      v.start = 0;
+      v.size = 0;
+      v.cap = 0;
+      _vars.push_back(v);
+      if (_declIdx)
+        vd->occIdx(r);
+      else
+        _byName.insert(vd->id(), r);
+    }
+    return r;
+  }
+
+  size_t VarOccurrences::lookup(unsigned int r, Item* i) const {
+    size_t mask = _occ.size()-1;
+    size_t h = occHash(r,i) & mask;
+    size_t deleted = _occ.size();
+    for (;;) {
+      const Occ& o = _occ[h];
+      if (o.var==r && _pool[_vars[r].start+o.pos]==i)
+        return h;
+      if (o.var==occ_empty)
+        return deleted==_occ.size() ? h : deleted;
+      if (o.var==occ_deleted && deleted==_occ.size())
+        deleted = h;
+      h = (h+1) & mask;
+    }
+  }
+
+  void VarOccurrences::rehash(size_t n) {
+    size_t cap = 16;
+    while (2*cap < 3*n)
+      cap *= 2;
+    std::vector<Occ> occ(cap);
+    for (size_t i=0; i<cap; i++)
+      occ[i].var = occ_empty;
+    _occ.swap(occ);
+    _occLive = 0;
+    _occUsed = 0;
+    for (size_t i=0; i<occ.size(); i++)
+      if (occ[i].var < occ_deleted)
+        insertOcc(occ[i].var, _pool[_vars[occ[i].var].start+occ[i].pos], occ[i].pos);
+  }
+
+  void VarOccurrences::insertOcc(unsigned int r, Item* i, unsigned int pos) {
+    if (4*(_occUsed+1) > 3*_occ.size())
+      rehash(_occLive+1);
+    size_t h = lookup(r,i);
+    assert(_occ[h].var >= occ_deleted);
+    if (_occ[h].var==occ_empty)
+      _occUsed++;
+    _occ[h].var = r;
+    _occ[h].pos = pos;
+    _occLive++;
+  }
+
+  int VarOccurrences::position(unsigned int r, Item* i) const {
+    const Var& v = _vars[r];
+    if (v.cap <= short_list) {
+      for (unsigned int j=0; j<v.size; j++)
+        if (_pool[v.start+j]==i)
+          return static_cast<int>(j);
+      return -1;
+    }
+    size_t h = lookup(r,i);
+    return _occ[h].var >= occ_deleted ? -1 : static_cast<int>(_occ[h].pos);
+  }
+
+  void VarOccurrences::addOcc(unsigned int r, Item* i) {
+    if (position(r,i) != -1)
+      return;
+    unsigned int size = _vars[r].size;
+    unsigned int cap = _vars[r].cap;
+    if (size==cap) {
+      // Grow segment in place at the end of the pool, or move it there
+      unsigned int ncap = cap==0 ? 2 : 2*cap;
+      if (cap==0 || _vars[r].start+cap != _pool.size()) {
+        if (_garbage > 1024 && 4*_garbage > _pool.size())
+          compactPool(false);
+        unsigned int start = _vars[r].start;
+        unsigned int nstart = static_cast<unsigned int>(_pool.size());
+        growPool(nstart+ncap);
+        std::copy(_pool.begin()+start, _pool.begin()+start+size, _pool.begin()+nstart);
+        _garbage += cap;
+        _vars[r].start = nstart;
+      } else {
+        growPool(_pool.size()+ncap-cap);
+      }
+      _vars[r].cap = ncap;
+      if (cap <= short_list && ncap > short_list) {
+        // The list becomes long, add its items to the table
+        for (unsigned int j=0; j<size; j++)
+          insertOcc(r, _pool[_vars[r].start+j], j);
+      }
+    }
+    _pool[_vars[r].start+size] = i;
+    _vars[r].size++;
+    if (_vars[r].cap > short_list)
+      insertOcc(r,i,size);
+  }
+
+  void VarOccurrences::removeOcc(unsigned int r, Item* i) {
+    int pos = position(r,i);
+    if (pos == -1)
+      return;
+    Var& v = _vars[r];
+    bool indexed = v.cap > short_list;
+    if (indexed) {
+      size_t h = lookup(r,i);
+      _occ[h].var = occ_deleted;
+      _occLive--;
+    }
+    v.size--;
+    if (static_cast<unsigned int>(pos) != v.size) {
+      Item* last = _pool[v.start+v.size];
+      _pool[v.start+pos] = last;
+      if (indexed)
+        _occ[lookup(r,last)].pos = pos;
+    }
+  }
+
+  void VarOccurrences::growPool(size_t n) {
+    if (n > _pool.capacity())
+      _pool.reserve(std::max(n, _pool.capacity()+_pool.capacity()/2));
+    _pool.resize(n);
+  }
+
+  void VarOccurrences::compactPool(bool dropRemoved) {
+    std::vector<Item*> pool;
+    pool.reserve(_pool.size()-_garbage);
+    for (unsigned int r=0; r<_vars.size(); r++) {
+      Var& v = _vars[r];
+      unsigned int start = static_cast<unsigned int>(pool.size());
+      for (unsigned int j=0; j<v.size; j++) {
+        Item* i = _pool[v.start+j];
+        if (!dropRemoved || !i->removed())
+          pool.push_back(i);
+      }
+      v.start = start;
+      v.size = static_cast<unsigned int>(pool.size())-start;
+      if (dropRemoved)
+        v.cap = v.size;
+      else
+        pool.resize(start+v.cap);
+    }
+    _pool.swap(pool);
+    _garbage = 0;
+    if (dropRemoved) {
+      // Positions and capacities have changed, rebuild the table
+      size_t n = 0;
+      for (unsigned int r=0; r<_vars.size(); r++)
+        if (_vars[r].cap > short_list)
+          n += _vars[r].size;
+      // Release the old table before allocating the new one
+      std::vector<Occ>().swap(_occ);
+      rehash(n);
+      for (unsigned int r=0; r<_vars.size(); r++)
+        if (_vars[r].cap > short_list)
+          for (unsigned int j=0; j<_vars[r].size; j++)
+            insertOcc(r, _pool[_vars[r].start+j], j);
+    }
+  }
+
   void VarOccurrences::add(VarDeclI *i, int idx_i)
   {
-    idx.insert(i->e()->id(), idx_i);
+    int r = addRecord(i->e());
+    if (_vars[r].idx == -1)
+      _vars[r].idx = idx_i;
   }
   void VarOccurrences::add(VarDecl *e, int idx_i)
   {
     assert(find(e) == -1);
-    idx.insert(e->id(), idx_i);
+    int r = addRecord(e);
+    if (_vars[r].idx == -1)
+      _vars[r].idx = idx_i;
   }
   int VarOccurrences::find(VarDecl* vd)
   {
-    IdMap<int>::iterator it = idx.find(vd->id());
-    return it==idx.end() ? -1 : it->second;
+    int r = record(vd);
+    return r==-1 ? -1 : _vars[r].idx;
   }
   void VarOccurrences::remove(VarDecl *vd)
   {
-    idx.remove(vd->id());
+    int r = record(vd);
+    if (r != -1)
+      _vars[r].idx = -1;
   }
   
   void VarOccurrences::add(VarDecl* v, Item* i) {
-    IdMap<Items>::iterator vi = _m.find(v->id()->decl()->id());
-    if (vi==_m.end()) {
-      Items items; items.insert(i);
-      _m.insert(v->id()->decl()->id(), items);
-    } else {
-      vi->second.insert(i);
-    }
+    addOcc(addRecord(v->id()->decl()), i);
   }
   
   int VarOccurrences::remove(VarDecl* v, Item* i) {
-    IdMap<Items>::iterator vi = _m.find(v->id()->decl()->id());
-    assert(vi!=_m.end());
-    vi->second.erase(i);
-    return vi->second.size();
+    int r = record(v->id()->decl());
+    assert(r != -1);
+    if (r == -1)
+      return 0;
+    removeOcc(r, i);
+    return _vars[r].size;
   }
   
   void VarOccurrences::unify(EnvI& env, Model* m, Id* id0_0, Id *id1_0) {
@@ -72,15 +267,16 @@ namespace MiniZinc {
     assert(v0idx != -1);
     env.flat_removeItem(v0idx);
 
-    IdMap<Items>::iterator vi0 = _m.find(v0->id());
-    if (vi0 != _m.end()) {
-      IdMap<Items>::iterator vi1 = _m.find(v1->id());
-      if (vi1 == _m.end()) {
-        _m.insert(v1->id(), vi0->second);
-      } else {
-        vi1->second.insert(vi0->second.begin(), vi0->second.end());
+    int r0 = record(v0);
+    if (r0 != -1 && _vars[r0].size > 0) {
+      int r1 = addRecord(v1);
+      while (_vars[r0].size > 0) {
+        Item* i = _pool[_vars[r0].start+_vars[r0].size-1];
+        removeOcc(r0, i);
+        addOcc(r1, i);
       }
-      _m.remove(v0->id());
+      _garbage += _vars[r0].cap;
+      _vars[r0].cap = 0;
     }
     
     id0->redirect(id1);
@@ -88,14 +284,27 @@ namespace MiniZinc {
     remove(v0);
   }
   
+  void VarOccurrences::compact(void) {
+    compactPool(true);
+  }
+
   void VarOccurrences::clear(void) {
-    _m.clear();
-    idx.clear();
+    _byName.clear();
+    _vars.clear();
+    _pool.clear();
+    _garbage = 0;
+    _occ.clear();
+    _occLive = 0;
+    _occUsed = 0;
   }
   
   int VarOccurrences::occurrences(VarDecl* v) {
-    IdMap<Items>::iterator vi = _m.find(v->id()->decl()->id());
-    return (vi==_m.end() ? 0 : vi->second.size());
+    int r = record(v->id()->decl());
+    return r==-1 ? 0 : _vars[r].size;
+  }
+
+  VarOccurrences::Items VarOccurrences::items(VarDecl* v) {
+    return Items(this, record(v->id()->decl()));
   }
   
   void CollectOccurrencesI::vVarDeclI(VarDeclI* v) {
@@ -158,10 +367,7 @@ namespace MiniZinc {
           if (id0->type().isint() || id0->type().isintset()) {
             IntSetVal* isv0 = eval_intset(env,id0->decl()->ti()->domain());
             IntSetVal* isv1 = eval_intset(env,id1->decl()->ti()->domain());
-            IntSetRanges isv0r(isv0);
-            IntSetRanges isv1r(isv1);
-            Ranges::Inter<IntSetRanges,IntSetRanges> inter(isv0r,isv1r);
-            IntSetVal* nd = IntSetVal::ai(inter);
+            IntSetVal* nd = IntSetVal::intersect(isv0,isv1);
             if (nd->size()==0) {
               env.flat()->fail(env);
             } else if (nd->card() != isv1->card()) {
@@ -241,22 +447,21 @@ namespace MiniZinc {
   }
   
   void pushDependentConstraints(EnvI& env, Id* id, std::vector<Item*>& q) {
-    IdMap<VarOccurrences::Items>::iterator it = env.vo._m.find(id->decl()->id());
-    if (it != env.vo._m.end()) {
-      for (VarOccurrences::Items::iterator item = it->second.begin(); item != it->second.end(); ++item) {
-        if (ConstraintI* ci = (*item)->dyn_cast<ConstraintI>()) {
-          if (!ci->removed() && !ci->flag()) {
-            ci->flag(true);
-            q.push_back(ci);
-          }
-        } else if (VarDeclI* vdi = (*item)->dyn_cast<VarDeclI>()) {
-          if (vdi->e()->id()->decl() != vdi->e()) {
-            vdi = (*env.flat())[env.vo.find(vdi->e()->id()->decl())]->cast<VarDeclI>();
-          }
-          if (!vdi->removed() && !vdi->flag() && vdi->e()->e()) {
-            vdi->flag(true);
-            q.push_back(vdi);
-          }
+    VarOccurrences::Items items = env.vo.items(id->decl());
+    for (unsigned int i=0; i<items.size(); i++) {
+      Item* item = items[i];
+      if (ConstraintI* ci = item->dyn_cast<ConstraintI>()) {
+        if (!ci->removed() && !ci->flag()) {
+          ci->flag(true);
+          q.push_back(ci);
+        }
+      } else if (VarDeclI* vdi = item->dyn_cast<VarDeclI>()) {
+        if (vdi->e()->id()->decl() != vdi->e()) {
+          vdi = (*env.flat())[env.vo.find(vdi->e()->id()->decl())]->cast<VarDeclI>();
+        }
+        if (!vdi->removed() && !vdi->flag() && vdi->e()->e()) {
+          vdi->flag(true);
+          q.push_back(vdi);
         }
       }
     }
@@ -315,7 +520,7 @@ namespace MiniZinc {
               for (unsigned int j=al->v().size(); j--;) {
                 if (Id* id = al->v()[j]->dyn_cast<Id>()) {
                   if (id->decl()->ti()->domain()==NULL) {
-                    toAssignBoolVars.push_back(envi.vo.idx.find(id->decl()->id())->second);
+                    toAssignBoolVars.push_back(envi.vo.find(id->decl()));
                   } else if (id->decl()->ti()->domain() == constants().lit_false) {
                     env.flat()->fail(env.envi());
                     id->decl()->e(constants().lit_true);
@@ -332,7 +537,7 @@ namespace MiniZinc {
               ci->e(constants().lit_false);
             } else {
               if (id->decl()->ti()->domain()==NULL) {
-                toAssignBoolVars.push_back(envi.vo.idx.find(id->decl()->id())->second);
+                toAssignBoolVars.push_back(envi.vo.find(id->decl()));
               }
               toRemoveConstraints.push_back(i);
             }
@@ -480,7 +685,7 @@ namespace MiniZinc {
         CollectDecls cd(envi.vo,deletedVarDecls,bi);
         topDown(cd,bi->cast<ConstraintI>()->e());
         bi->remove();
-        pushVarDecl(envi, envi.vo.idx.find(finalId->decl()->id())->second, vardeclQueue);
+        pushVarDecl(envi, envi.vo.find(finalId->decl()), vardeclQueue);
         pushDependentConstraints(envi, finalId, constraintQueue);
       }
     }
@@ -511,7 +716,7 @@ namespace MiniZinc {
             if (Id* id = vd->e()->dyn_cast<Id>()) {
               if (id->decl()->ti()->domain()==NULL) {
                 id->decl()->ti()->domain(vd->ti()->domain());
-                pushVarDecl(envi, envi.vo.idx.find(id->decl()->id())->second, vardeclQueue);
+                pushVarDecl(envi, envi.vo.find(id->decl()), vardeclQueue);
               } else if (id->decl()->ti()->domain() != vd->ti()->domain()) {
                 env.flat()->fail(env.envi());
               }
@@ -524,7 +729,7 @@ namespace MiniZinc {
                   if (Id* id = al->v()[i]->dyn_cast<Id>()) {
                     if (id->decl()->ti()->domain()==NULL) {
                       id->decl()->ti()->domain(constants().lit_true);
-                      pushVarDecl(envi, envi.vo.idx.find(id->decl()->id())->second, vardeclQueue);
+                      pushVarDecl(envi, envi.vo.find(id->decl()), vardeclQueue);
                     } else if (id->decl()->ti()->domain() == constants().lit_false) {
                       env.flat()->fail(env.envi());
                       remove = true;
@@ -540,7 +745,7 @@ namespace MiniZinc {
                     if (Id* id = al->v()[j]->dyn_cast<Id>()) {
                       if (id->decl()->ti()->domain()==NULL) {
                         id->decl()->ti()->domain(constants().boollit(!ispos));
-                        pushVarDecl(envi, envi.vo.idx.find(id->decl()->id())->second, vardeclQueue);
+                        pushVarDecl(envi, envi.vo.find(id->decl()), vardeclQueue);
                       } else if (id->decl()->ti()->domain() == constants().boollit(ispos)) {
                         env.flat()->fail(env.envi());
                         remove = true;
@@ -555,24 +760,21 @@ namespace MiniZinc {
           }
           pushDependentConstraints(envi, vd->id(), constraintQueue);
           std::vector<Item*> toRemove;
-          IdMap<VarOccurrences::Items>::iterator it = envi.vo._m.find(vd->id()->decl()->id());
-          if (it != envi.vo._m.end()) {
-            for (VarOccurrences::Items::iterator item = it->second.begin(); item != it->second.end(); ++item) {
-              if ((*item)->removed())
-                continue;
-              if (VarDeclI* vdi = (*item)->dyn_cast<VarDeclI>()) {
-                if (vdi->e()->e() && vdi->e()->e()->isa<ArrayLit>()) {
-                  IdMap<VarOccurrences::Items>::iterator ait = envi.vo._m.find(vdi->e()->id()->decl()->id());
-                  if (ait != envi.vo._m.end()) {
-                    for (VarOccurrences::Items::iterator aitem = ait->second.begin(); aitem != ait->second.end(); ++aitem) {
-                      simplifyBoolConstraint(envi,*aitem,vd,remove,vardeclQueue,constraintQueue,toRemove,nonFixedLiteralCount);
-                    }
-                  }
-                  continue;
+          VarOccurrences::Items items = envi.vo.items(vd);
+          for (unsigned int j=0; j<items.size(); j++) {
+            Item* item = items[j];
+            if (item->removed())
+              continue;
+            if (VarDeclI* vdi = item->dyn_cast<VarDeclI>()) {
+              if (vdi->e()->e() && vdi->e()->e()->isa<ArrayLit>()) {
+                VarOccurrences::Items aitems = envi.vo.items(vdi->e());
+                for (unsigned int k=0; k<aitems.size(); k++) {
+                  simplifyBoolConstraint(envi,aitems[k],vd,remove,vardeclQueue,constraintQueue,toRemove,nonFixedLiteralCount);
                 }
+                continue;
               }
-              simplifyBoolConstraint(envi,*item,vd,remove,vardeclQueue,constraintQueue,toRemove,nonFixedLiteralCount);
             }
+            simplifyBoolConstraint(envi,item,vd,remove,vardeclQueue,constraintQueue,toRemove,nonFixedLiteralCount);
           }
           for (unsigned int i=toRemove.size(); i--;) {
             if (ConstraintI* ci = toRemove[i]->dyn_cast<ConstraintI>()) {
@@ -723,8 +925,8 @@ namespace MiniZinc {
     while (!deletedVarDecls.empty()) {
       VarDecl* cur = deletedVarDecls.back(); deletedVarDecls.pop_back();
       if (envi.vo.occurrences(cur) == 0) {
-        IdMap<int>::iterator cur_idx = envi.vo.idx.find(cur->id());
-        if (cur_idx != envi.vo.idx.end() && !m[cur_idx->second]->removed()) {
+        int cur_idx = envi.vo.find(cur);
+        if (cur_idx != -1 && !m[cur_idx]->removed()) {
           if (isOutput(cur)) {
             Expression* val = NULL;
             if (cur->type().isbool() && cur->ti()->domain()) {
@@ -741,14 +943,14 @@ namespace MiniZinc {
             if (val) {
               VarDecl* vd_out = (*envi.output)[envi.output_vo.find(cur)]->cast<VarDeclI>()->e();
               vd_out->e(val);
-              CollectDecls cd(envi.vo,deletedVarDecls,m[cur_idx->second]->cast<VarDeclI>());
+              CollectDecls cd(envi.vo,deletedVarDecls,m[cur_idx]->cast<VarDeclI>());
               topDown(cd,cur->e());
-              envi.flat_removeItem(cur_idx->second);
+              envi.flat_removeItem(cur_idx);
             }
           } else {
-            CollectDecls cd(envi.vo,deletedVarDecls,m[cur_idx->second]->cast<VarDeclI>());
+            CollectDecls cd(envi.vo,deletedVarDecls,m[cur_idx]->cast<VarDeclI>());
             topDown(cd,cur->e());
-            envi.flat_removeItem(cur_idx->second);
+            envi.flat_removeItem(cur_idx);
           }
         }
       }
@@ -1172,7 +1374,7 @@ namespace MiniZinc {
         assert(id->decl()==vd);
         if (vdi->e()->ti()->domain()==NULL) {
           vdi->e()->ti()->domain(constants().boollit(isTrue));
-          vardeclQueue.push_back(env.vo.idx.find(vdi->e()->id())->second);
+          vardeclQueue.push_back(env.vo.find(vdi->e()));
         } else if (id->decl()->ti()->domain() == constants().boollit(!isTrue)) {
           env.flat()->fail(env);
           remove = false;
@@ -1205,7 +1407,7 @@ namespace MiniZinc {
         if (b0s != b1s) {
           if (b1s==2) {
             b1->cast<Id>()->decl()->ti()->domain(constants().boollit(isTrue));
-            vardeclQueue.push_back(env.vo.idx.find(b1->cast<Id>()->decl()->id())->second);
+            vardeclQueue.push_back(env.vo.find(b1->cast<Id>()->decl()));
             if (ci)
               toRemove.push_back(ci);
           } else {
@@ -1220,7 +1422,7 @@ namespace MiniZinc {
         if (b0s != b1s) {
           if (b1s==2) {
             b1->cast<Id>()->decl()->ti()->domain(constants().boollit(isTrue));
-            vardeclQueue.push_back(env.vo.idx.find(b1->cast<Id>()->decl()->id())->second);
+            vardeclQueue.push_back(env.vo.find(b1->cast<Id>()->decl()));
           }
         } else {
           env.flat()->fail(env);
@@ -1236,7 +1438,7 @@ namespace MiniZinc {
         } else {
           if (vdi->e()->ti()->domain()==NULL) {
             vdi->e()->ti()->domain(constants().lit_true);
-            vardeclQueue.push_back(env.vo.idx.find(vdi->e()->id())->second);
+            vardeclQueue.push_back(env.vo.find(vdi->e()));
           } else if (vdi->e()->ti()->domain()!=constants().lit_true) {
             env.flat()->fail(env);
             vdi->e()->e(constants().lit_true);
@@ -1249,7 +1451,7 @@ namespace MiniZinc {
         } else {
           if (vdi->e()->ti()->domain()==NULL) {
             vdi->e()->ti()->domain(constants().lit_false);
-            vardeclQueue.push_back(env.vo.idx.find(vdi->e()->id())->second);
+            vardeclQueue.push_back(env.vo.find(vdi->e()));
           } else if (vdi->e()->ti()->domain()!=constants().lit_false) {
             env.flat()->fail(env);
             vdi->e()->e(constants().lit_false);
@@ -1302,7 +1504,7 @@ namespace MiniZinc {
             } else {
               if (vdi->e()->ti()->domain()==NULL) {
                 vdi->e()->ti()->domain(constants().boollit(!isConjunction));
-                vardeclQueue.push_back(env.vo.idx.find(vdi->e()->id())->second);
+                vardeclQueue.push_back(env.vo.find(vdi->e()));
               } else if (vdi->e()->ti()->domain()!=constants().boollit(!isConjunction)) {
                 env.flat()->fail(env);
                 vdi->e()->e(constants().boollit(!isConjunction));
@@ -1319,7 +1521,7 @@ namespace MiniZinc {
             } else {
               if (vdi->e()->ti()->domain()==NULL) {
                 vdi->e()->ti()->domain(constants().boollit(isConjunction));
-                vardeclQueue.push_back(env.vo.idx.find(vdi->e()->id())->second);
+                vardeclQueue.push_back(env.vo.find(vdi->e()));
               } else if (vdi->e()->ti()->domain()!=constants().boollit(isConjunction)) {
                 env.flat()->fail(env);
                 vdi->e()->e(constants().boollit(isConjunction));
@@ -1338,7 +1540,7 @@ namespace MiniZinc {
               VarDecl* vd = id->decl();
               if (vd->ti()->domain()==NULL) {
                 vd->ti()->domain(constants().boollit(result));
-                vardeclQueue.push_back(env.vo.idx.find(vd->id())->second);
+                vardeclQueue.push_back(env.vo.find(vd));
               } else if (vd->ti()->domain()!=constants().boollit(result)) {
                 env.flat()->fail(env);
                 vd->e(constants().lit_true);
@@ -1368,7 +1570,7 @@ namespace MiniZinc {
                 Id* id = al->v()[0]->cast<Id>();
                 if (id->decl()->ti()->domain()==NULL) {
                   id->decl()->ti()->domain(constants().boollit(isTrue));
-                  vardeclQueue.push_back(env.vo.idx.find(id->decl()->id())->second);
+                  vardeclQueue.push_back(env.vo.find(id->decl()));
                 } else {
                   if (id->decl()->ti()->domain()==constants().boollit(isTrue)) {
                     toRemove.push_back(ci);
@@ -1388,7 +1590,7 @@ namespace MiniZinc {
                 } else {
                   if (vdi->e()->ti()->domain()==NULL) {
                     vdi->e()->ti()->domain(constants().lit_true);
-                    vardeclQueue.push_back(env.vo.idx.find(vdi->e()->id())->second);
+                    vardeclQueue.push_back(env.vo.find(vdi->e()));
                   } else if (vdi->e()->ti()->domain()!=constants().lit_true) {
                     env.flat()->fail(env);
                     vdi->e()->e(constants().lit_true);
@@ -0,0 +1,932 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <minizinc/parser_cache.hh>
+#include <minizinc/hash.hh>
+#include <minizinc/config.hh>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+
+#ifdef _MSC_VER
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace MiniZinc {
+
+  namespace {
+
+    /// Magic number at the start of every cache file
+    const unsigned int cacheMagic = 0x434e5a4d;
+    /// Version of the cache file format
+    const unsigned int cacheFormat = 2;
+
+    /// Tags for expressions that are not stored using their expression id
+    enum CacheTag {
+      CT_NULL = 0, CT_TRUE = 1, CT_FALSE = 2,
+      CT_ABSENT = Expression::EID_END+1
+    };
+
+    /// FNV-1a hash of \a n bytes starting at \a s
+    unsigned long long int fnv1a(const char* s, size_t n) {
+      unsigned long long int h = 14695981039346656037ULL;
+      for (size_t i=0; i<n; i++) {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 1099511628211ULL;
+      }
+      return h;
+    }
+
+    /// Return name of the cache file for \a fullname
+    std::string cacheFileName(const std::string& cacheDir, const std::string& fullname) {
+      std::ostringstream oss;
+      oss << cacheDir << "/" << std::hex << std::setw(16) << std::setfill('0')
+          << fnv1a(fullname.c_str(), fullname.size()) << ".mznc";
+      return oss.str();
+    }
+
+    /// Return version of the compiler that writes the cache
+    std::string cacheVersion(void) {
+      return std::string(MZN_VERSION_MAJOR)+"."+MZN_VERSION_MINOR+"."+MZN_VERSION_PATCH;
+    }
+
+    /// Writer for cache files
+    class CacheWriter {
+    protected:
+      /// Items and expressions
+      std::string _body;
+      /// Indices of strings in the string table
+      UNORDERED_NAMESPACE::unordered_map<std::string,unsigned int> _stringIdx;
+      /// The string table
+      std::vector<std::string> _strings;
+      /// Whether only supported expressions have been written
+      bool _ok;
+
+      template<class T> static void put(std::string& s, T v) {
+        s.append(reinterpret_cast<const char*>(&v), sizeof(T));
+      }
+      static void putString(std::string& s, const std::string& str) {
+        put<unsigned int>(s, str.size());
+        s += str;
+      }
+      template<class T> void wp(T v) { put<T>(_body, v); }
+      void w(const ASTString& s) {
+        if (s.aststr()==NULL) {
+          wp<unsigned int>(0);
+          return;
+        }
+        std::string str = s.str();
+        UNORDERED_NAMESPACE::unordered_map<std::string,unsigned int>::iterator it = _stringIdx.find(str);
+        if (it==_stringIdx.end()) {
+          _strings.push_back(str);
+          it = _stringIdx.insert(std::make_pair(str, _strings.size())).first;
+        }
+        wp<unsigned int>(it->second);
+      }
+      void w(const IntVal& v) {
+        if (v.isFinite()) {
+          wp<unsigned char>(0);
+          wp<long long int>(v.toInt());
+        } else {
+          wp<unsigned char>(v.isPlusInfinity() ? 1 : 2);
+        }
+      }
+      void w(const Location& loc) {
+        w(loc.filename);
+        wp<unsigned int>(loc.first_line);
+        wp<unsigned int>(loc.first_column);
+        wp<unsigned int>(loc.last_line);
+        wp<unsigned int>(loc.last_column);
+        wp<unsigned char>(loc.is_introduced);
+      }
+      void w(const Annotation& ann) {
+        std::vector<Expression*> a;
+        for (ExpressionSetIter it = ann.begin(); it != ann.end(); ++it)
+          a.push_back(*it);
+        wp<unsigned int>(a.size());
+        for (unsigned int i=0; i<a.size(); i++)
+          w(a[i]);
+      }
+      template<class E> void w(ASTExprVec<E> v) {
+        wp<unsigned int>(v.size());
+        for (unsigned int i=0; i<v.size(); i++)
+          w(v[i]);
+      }
+      void w(Expression* e) {
+        if (e==NULL) {
+          wp<unsigned char>(CT_NULL);
+          return;
+        }
+        if (e==constants().absent) {
+          wp<unsigned char>(CT_ABSENT);
+          return;
+        }
+        if (BoolLit* bl = e->dyn_cast<BoolLit>()) {
+          // The parser only creates the shared Boolean constants
+          _ok = _ok && bl==constants().boollit(bl->v()) && bl->ann().isEmpty();
+          wp<unsigned char>(bl->v() ? CT_TRUE : CT_FALSE);
+          return;
+        }
+        wp<unsigned char>(e->eid());
+        w(e->loc());
+        wp<int>(e->type().toInt());
+        wp<unsigned char>(e->type().cv());
+        w(e->ann());
+        switch (e->eid()) {
+        case Expression::E_INTLIT:
+          w(e->cast<IntLit>()->v());
+          break;
+        case Expression::E_FLOATLIT:
+          wp<FloatVal>(e->cast<FloatLit>()->v());
+          break;
+        case Expression::E_SETLIT:
+          {
+            SetLit* sl = e->cast<SetLit>();
+            if (IntSetVal* isv = sl->isv()) {
+              wp<unsigned char>(1);
+              wp<unsigned int>(isv->size());
+              for (int i=0; i<isv->size(); i++) {
+                w(isv->min(i));
+                w(isv->max(i));
+              }
+            } else {
+              wp<unsigned char>(0);
+              w(sl->v());
+            }
+          }
+          break;
+        case Expression::E_STRINGLIT:
+          w(e->cast<StringLit>()->v());
+          break;
+        case Expression::E_ID:
+          {
+            Id* id = e->cast<Id>();
+            _ok = _ok && id->idn()==-1 && id->decl()==NULL;
+            w(id->v());
+          }
+          break;
+        case Expression::E_ANON:
+          break;
+        case Expression::E_ARRAYLIT:
+          {
+            ArrayLit* al = e->cast<ArrayLit>();
+            wp<unsigned int>(al->dims());
+            for (int i=0; i<al->dims(); i++) {
+              wp<int>(al->min(i));
+              wp<int>(al->max(i));
+            }
+            w(al->v());
+          }
+          break;
+        case Expression::E_ARRAYACCESS:
+          w(e->cast<ArrayAccess>()->v());
+          w(e->cast<ArrayAccess>()->idx());
+          break;
+        case Expression::E_COMP:
+          {
+            Comprehension* c = e->cast<Comprehension>();
+            wp<unsigned char>(c->set());
+            w(c->e());
+            w(c->where());
+            wp<unsigned int>(c->n_generators());
+            for (int i=0; i<c->n_generators(); i++) {
+              wp<unsigned int>(c->n_decls(i));
+              for (int j=0; j<c->n_decls(i); j++)
+                w(c->decl(i,j));
+              w(c->in(i));
+            }
+          }
+          break;
+        case Expression::E_ITE:
+          {
+            ITE* ite = e->cast<ITE>();
+            wp<unsigned int>(ite->size());
+            for (int i=0; i<ite->size(); i++) {
+              w(ite->e_if(i));
+              w(ite->e_then(i));
+            }
+            w(ite->e_else());
+          }
+          break;
+        case Expression::E_BINOP:
+          {
+            BinOp* bo = e->cast<BinOp>();
+            _ok = _ok && bo->decl()==NULL;
+            wp<unsigned char>(bo->op());
+            w(bo->lhs());
+            w(bo->rhs());
+          }
+          break;
+        case Expression::E_UNOP:
+          {
+            UnOp* uo = e->cast<UnOp>();
+            _ok = _ok && uo->decl()==NULL;
+            wp<unsigned char>(uo->op());
+            w(uo->e());
+          }
+          break;
+        case Expression::E_CALL:
+          {
+            Call* c = e->cast<Call>();
+            _ok = _ok && c->decl()==NULL;
+            w(c->id());
+            w(c->args());
+          }
+          break;
+        case Expression::E_VARDECL:
+          {
+            VarDecl* vd = e->cast<VarDecl>();
+            _ok = _ok && vd->id()->idn()==-1 && vd->id()->ann().isEmpty();
+            w(vd->id()->v());
+            w(vd->ti());
+            w(vd->e());
+            wp<unsigned char>(vd->toplevel());
+            wp<unsigned char>(vd->introduced());
+          }
+          break;
+        case Expression::E_LET:
+          w(e->cast<Let>()->let());
+          w(e->cast<Let>()->in());
+          break;
+        case Expression::E_TI:
+          w(e->cast<TypeInst>()->ranges());
+          w(e->cast<TypeInst>()->domain());
+          break;
+        case Expression::E_TIID:
+          w(e->cast<TIId>()->v());
+          break;
+        default:
+          _ok = false;
+        }
+      }
+      void w(Item* item) {
+        wp<unsigned char>(item->iid());
+        w(item->loc());
+        switch (item->iid()) {
+        case Item::II_INC:
+          w(item->cast<IncludeI>()->f());
+          break;
+        case Item::II_VD:
+          w(item->cast<VarDeclI>()->e());
+          break;
+        case Item::II_ASN:
+          w(item->cast<AssignI>()->id());
+          w(item->cast<AssignI>()->e());
+          break;
+        case Item::II_CON:
+          w(item->cast<ConstraintI>()->e());
+          break;
+        case Item::II_SOL:
+          wp<unsigned char>(item->cast<SolveI>()->st());
+          w(item->cast<SolveI>()->e());
+          w(item->cast<SolveI>()->ann());
+          break;
+        case Item::II_OUT:
+          w(item->cast<OutputI>()->e());
+          break;
+        case Item::II_FUN:
+          {
+            FunctionI* fi = item->cast<FunctionI>();
+            w(fi->id());
+            w(fi->ti());
+            w(fi->params());
+            w(fi->e());
+            w(fi->ann());
+          }
+          break;
+        }
+      }
+    public:
+      CacheWriter(void) : _ok(true) {}
+      /// Write the doc comment of \a m and its items starting at index \a first
+      void write(Model* m, unsigned int first) {
+        putString(_body, m->docComment());
+        wp<unsigned int>(m->size()-first);
+        for (unsigned int i=first; i<m->size(); i++)
+          w((*m)[i]);
+      }
+      /// Return snapshot (header and body) of the items for \a fullname, or empty string
+      std::string snapshot(const std::string& fullname, const char* contents, size_t size,
+                           bool parseDocComments) {
+        if (!_ok)
+          return std::string();
+        std::string header;
+        put<unsigned int>(header, cacheMagic);
+        put<unsigned int>(header, cacheFormat);
+        putString(header, cacheVersion());
+        putString(header, fullname);
+        put<unsigned long long int>(header, size);
+        put<unsigned long long int>(header, fnv1a(contents, size));
+        put<unsigned char>(header, parseDocComments);
+        // The string table and the body are protected by their own hash,
+        // so that a corrupted snapshot is rejected before it is read
+        std::string payload;
+        put<unsigned int>(payload, _strings.size());
+        for (unsigned int i=0; i<_strings.size(); i++)
+          putString(payload, _strings[i]);
+        payload += _body;
+        put<unsigned long long int>(header, payload.size());
+        put<unsigned long long int>(header, fnv1a(payload.c_str(), payload.size()));
+        return header+payload;
+      }
+      /// Write \a snapshot to cache file \a filename
+      static bool save(const std::string& filename, const std::string& snapshot) {
+        // Write to a temporary file first, so that concurrent compilations
+        // never see a partially written cache file
+        std::ostringstream tmpname;
+        tmpname << filename << "." << getpid();
+        {
+          std::ofstream os(tmpname.str().c_str(), std::ios::binary);
+          if (!os.is_open())
+            return false;
+          os.write(snapshot.c_str(), snapshot.size());
+          if (!os.good()) {
+            os.close();
+            std::remove(tmpname.str().c_str());
+            return false;
+          }
+        }
+#ifdef _MSC_VER
+        std::remove(filename.c_str());
+#endif
+        if (std::rename(tmpname.str().c_str(), filename.c_str()) != 0) {
+          std::remove(tmpname.str().c_str());
+          return false;
+        }
+        return true;
+      }
+    };
+
+    /// Reader for cache files
+    class CacheReader {
+    protected:
+      /// Current position
+      const char* _p;
+      /// End of input
+      const char* _end;
+      /// Whether the input has been well-formed so far
+      bool _ok;
+      /// The string table (index 0 is the empty string)
+      std::vector<ASTString> _strings;
+
+      template<class T> T r(void) {
+        T v = T();
+        if (static_cast<size_t>(_end-_p) < sizeof(T)) {
+          _ok = false;
+          _p = _end;
+        } else {
+          memcpy(&v, _p, sizeof(T));
+          _p += sizeof(T);
+        }
+        return v;
+      }
+      /// Read a count of objects that are at least \a minSize bytes each
+      unsigned int rCount(unsigned int minSize=1) {
+        unsigned int n = r<unsigned int>();
+        if (n > static_cast<size_t>(_end-_p)/minSize) {
+          _ok = false;
+          _p = _end;
+          return 0;
+        }
+        return n;
+      }
+      std::string rString(void) {
+        unsigned int n = rCount();
+        std::string s(_p, n);
+        _p += n;
+        return s;
+      }
+      ASTString rASTString(void) {
+        unsigned int i = r<unsigned int>();
+        if (i >= _strings.size()) {
+          _ok = false;
+          return ASTString();
+        }
+        return _strings[i];
+      }
+      IntVal rIntVal(void) {
+        switch (r<unsigned char>()) {
+        case 0:
+          {
+            long long int v = r<long long int>();
+            if (v==LLONG_MAX || v==LLONG_MIN) {
+              _ok = false;
+              return IntVal();
+            }
+            return IntVal(v);
+          }
+        case 1: return IntVal::infinity();
+        case 2: return -IntVal::infinity();
+        default: _ok = false; return IntVal();
+        }
+      }
+      Location rLocation(void) {
+        Location loc;
+        loc.filename = rASTString();
+        loc.first_line = r<unsigned int>();
+        loc.first_column = r<unsigned int>();
+        loc.last_line = r<unsigned int>();
+        loc.last_column = r<unsigned int>();
+        loc.is_introduced = r<unsigned char>();
+        return loc;
+      }
+      std::vector<Expression*> rExprs(void) {
+        std::vector<Expression*> v(rCount());
+        for (unsigned int i=0; i<v.size(); i++)
+          v[i] = rExpr();
+        return v;
+      }
+      template<class E> E* rExpr(void) {
+        Expression* e = rExpr();
+        if (e != NULL && !e->isa<E>()) {
+          _ok = false;
+          return NULL;
+        }
+        return static_cast<E*>(e);
+      }
+      Expression* rExpr(void) {
+        if (!_ok)
+          return NULL;
+        unsigned char tag = r<unsigned char>();
+        switch (tag) {
+        case CT_NULL: return NULL;
+        case CT_TRUE: return constants().lit_true;
+        case CT_FALSE: return constants().lit_false;
+        case CT_ABSENT: return constants().absent;
+        default: break;
+        }
+        Location loc = rLocation();
+        Type t = Type::fromInt(r<int>());
+        t.cv(r<unsigned char>());
+        std::vector<Expression*> ann = rExprs();
+        if (!_ok)
+          return NULL;
+        // Each case reads all children before it creates the node, and
+        // gives up as soon as the input turned out to be malformed
+        Expression* ret = NULL;
+        switch (tag) {
+        case Expression::E_INTLIT:
+          {
+            IntVal v = rIntVal();
+            if (!_ok)
+              return NULL;
+            ret = new IntLit(loc, v);
+          }
+          break;
+        case Expression::E_FLOATLIT:
+          {
+            FloatVal v = r<FloatVal>();
+            if (!_ok)
+              return NULL;
+            ret = new FloatLit(loc, v);
+          }
+          break;
+        case Expression::E_SETLIT:
+          if (r<unsigned char>()) {
+            std::vector<IntSetVal::Range> ranges(rCount());
+            for (unsigned int i=0; i<ranges.size(); i++) {
+              ranges[i].min = rIntVal();
+              ranges[i].max = rIntVal();
+            }
+            if (!_ok)
+              return NULL;
+            ret = new SetLit(loc, IntSetVal::a(ranges));
+          } else {
+            std::vector<Expression*> v = rExprs();
+            if (!_ok)
+              return NULL;
+            ret = new SetLit(loc, v);
+          }
+          break;
+        case Expression::E_STRINGLIT:
+          {
+            ASTString v = rASTString();
+            if (!_ok)
+              return NULL;
+            ret = new StringLit(loc, v);
+          }
+          break;
+        case Expression::E_ID:
+          {
+            ASTString v = rASTString();
+            if (!_ok)
+              return NULL;
+            ret = new Id(loc, v, NULL);
+          }
+          break;
+        case Expression::E_ANON:
+          ret = new AnonVar(loc);
+          break;
+        case Expression::E_ARRAYLIT:
+          {
+            std::vector<std::pair<int,int> > dims(rCount(2*sizeof(int)));
+            long long int n = 1;
+            for (unsigned int i=0; i<dims.size() && _ok; i++) {
+              dims[i].first = r<int>();
+              dims[i].second = r<int>();
+              long long int size = static_cast<long long int>(dims[i].second)-dims[i].first+1;
+              if (size < 0 || (size > 0 && n > (1LL << 32)/size))
+                _ok = false;
+              else
+                n *= size;
+            }
+            std::vector<Expression*> v = rExprs();
+            if (!_ok || (!dims.empty() && n != static_cast<long long int>(v.size()))) {
+              _ok = false;
+              return NULL;
+            }
+            ret = new ArrayLit(loc, v, dims);
+          }
+          break;
+        case Expression::E_ARRAYACCESS:
+          {
+            Expression* v = rExpr();
+            std::vector<Expression*> idx = rExprs();
+            if (!_ok || v==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            ret = new ArrayAccess(loc, v, idx);
+          }
+          break;
+        case Expression::E_COMP:
+          {
+            bool set = r<unsigned char>();
+            Expression* e = rExpr();
+            Generators g;
+            g._w = rExpr();
+            unsigned int n = rCount();
+            for (unsigned int i=0; i<n; i++) {
+              std::vector<VarDecl*> decls(rCount());
+              for (unsigned int j=0; j<decls.size(); j++) {
+                decls[j] = rExpr<VarDecl>();
+                if (decls[j]==NULL)
+                  _ok = false;
+              }
+              Expression* in = rExpr();
+              if (!_ok || in==NULL) {
+                _ok = false;
+                return NULL;
+              }
+              g._g.push_back(Generator(decls, in));
+            }
+            if (!_ok || e==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            ret = new Comprehension(loc, e, g, set);
+          }
+          break;
+        case Expression::E_ITE:
+          {
+            std::vector<Expression*> ifthen(2*rCount());
+            for (unsigned int i=0; i<ifthen.size(); i++)
+              ifthen[i] = rExpr();
+            Expression* e_else = rExpr();
+            if (!_ok)
+              return NULL;
+            ret = new ITE(loc, ifthen, e_else);
+          }
+          break;
+        case Expression::E_BINOP:
+          {
+            unsigned char op = r<unsigned char>();
+            Expression* lhs = rExpr();
+            Expression* rhs = rExpr();
+            if (!_ok || op > BOT_DOTDOT || lhs==NULL || rhs==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            ret = new BinOp(loc, lhs, static_cast<BinOpType>(op), rhs);
+          }
+          break;
+        case Expression::E_UNOP:
+          {
+            unsigned char op = r<unsigned char>();
+            Expression* e = rExpr();
+            if (!_ok || op > UOT_MINUS || e==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            ret = new UnOp(loc, static_cast<UnOpType>(op), e);
+          }
+          break;
+        case Expression::E_CALL:
+          {
+            ASTString id = rASTString();
+            std::vector<Expression*> args = rExprs();
+            if (!_ok)
+              return NULL;
+            ret = new Call(loc, id, args);
+          }
+          break;
+        case Expression::E_VARDECL:
+          {
+            ASTString id = rASTString();
+            TypeInst* ti = rExpr<TypeInst>();
+            Expression* e = rExpr();
+            bool toplevel = r<unsigned char>();
+            bool introduced = r<unsigned char>();
+            if (!_ok || ti==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            VarDecl* vd = new VarDecl(loc, ti, id, e);
+            vd->toplevel(toplevel);
+            vd->introduced(introduced);
+            ret = vd;
+          }
+          break;
+        case Expression::E_LET:
+          {
+            std::vector<Expression*> let = rExprs();
+            Expression* in = rExpr();
+            if (!_ok)
+              return NULL;
+            ret = new Let(loc, let, in);
+          }
+          break;
+        case Expression::E_TI:
+          {
+            std::vector<TypeInst*> ranges(rCount());
+            for (unsigned int i=0; i<ranges.size(); i++)
+              ranges[i] = rExpr<TypeInst>();
+            Expression* domain = rExpr();
+            if (!_ok)
+              return NULL;
+            ret = new TypeInst(loc, t, ASTExprVec<TypeInst>(ranges), domain);
+          }
+          break;
+        case Expression::E_TIID:
+          {
+            ASTString v = rASTString();
+            if (!_ok)
+              return NULL;
+            ret = new TIId(loc, v.str());
+          }
+          break;
+        default:
+          _ok = false;
+          return NULL;
+        }
+        ret->type(t);
+        if (!ann.empty())
+          ret->addAnnotations(ann);
+        return ret;
+      }
+      Item* rItem(void) {
+        unsigned char tag = r<unsigned char>();
+        Location loc = rLocation();
+        if (!_ok)
+          return NULL;
+        switch (tag) {
+        case Item::II_INC:
+          {
+            ASTString f = rASTString();
+            return _ok ? new IncludeI(loc, f) : NULL;
+          }
+        case Item::II_VD:
+          {
+            VarDecl* vd = rExpr<VarDecl>();
+            if (!_ok || vd==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            return new VarDeclI(loc, vd);
+          }
+        case Item::II_ASN:
+          {
+            std::string id = rASTString().str();
+            Expression* e = rExpr();
+            if (!_ok || e==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            return new AssignI(loc, id, e);
+          }
+        case Item::II_CON:
+          {
+            Expression* e = rExpr();
+            if (!_ok || e==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            return new ConstraintI(loc, e);
+          }
+        case Item::II_SOL:
+          {
+            unsigned char st = r<unsigned char>();
+            Expression* e = rExpr();
+            std::vector<Expression*> ann = rExprs();
+            if (!_ok || (st != SolveI::ST_SAT && e==NULL)) {
+              _ok = false;
+              return NULL;
+            }
+            SolveI* si;
+            switch (st) {
+            case SolveI::ST_SAT: si = SolveI::sat(loc); break;
+            case SolveI::ST_MIN: si = SolveI::min(loc, e); break;
+            case SolveI::ST_MAX: si = SolveI::max(loc, e); break;
+            default: _ok = false; return NULL;
+            }
+            if (!ann.empty())
+              si->ann().add(ann);
+            return si;
+          }
+        case Item::II_OUT:
+          {
+            Expression* e = rExpr();
+            if (!_ok || e==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            return new OutputI(loc, e);
+          }
+        case Item::II_FUN:
+          {
+            std::string id = rASTString().str();
+            TypeInst* ti = rExpr<TypeInst>();
+            std::vector<VarDecl*> params(rCount());
+            for (unsigned int i=0; i<params.size(); i++) {
+              params[i] = rExpr<VarDecl>();
+              if (params[i]==NULL)
+                _ok = false;
+            }
+            Expression* e = rExpr();
+            std::vector<Expression*> ann = rExprs();
+            if (!_ok || ti==NULL) {
+              _ok = false;
+              return NULL;
+            }
+            FunctionI* fi = new FunctionI(loc, id, ti, params, e);
+            if (!ann.empty())
+              fi->ann().add(ann);
+            return fi;
+          }
+        default:
+          _ok = false;
+          return NULL;
+        }
+      }
+    public:
+      CacheReader(const char* begin, const char* end)
+        : _p(begin), _end(end), _ok(true) {}
+      /// Read header and check that it matches \a fullname and \a size bytes of \a contents
+      bool header(const std::string& fullname, const char* contents, size_t size,
+                  bool parseDocComments) {
+        if (r<unsigned int>() != cacheMagic || r<unsigned int>() != cacheFormat ||
+            rString() != cacheVersion() || rString() != fullname ||
+            r<unsigned long long int>() != size ||
+            r<unsigned long long int>() != fnv1a(contents, size) ||
+            r<unsigned char>() != parseDocComments)
+          return false;
+        unsigned long long int payloadSize = r<unsigned long long int>();
+        unsigned long long int payloadHash = r<unsigned long long int>();
+        if (!_ok || payloadSize != static_cast<unsigned long long int>(_end-_p) ||
+            payloadHash != fnv1a(_p, _end-_p))
+          return false;
+        unsigned int n = rCount(sizeof(unsigned int));
+        _strings.resize(n+1);
+        for (unsigned int i=1; i<=n; i++)
+          _strings[i] = ASTString(rString());
+        return _ok;
+      }
+      /// Read doc comment and items into \a m
+      bool read(Model* m) {
+        std::string docComment = rString();
+        std::vector<Item*> items(rCount());
+        for (unsigned int i=0; i<items.size() && _ok; i++)
+          items[i] = rItem();
+        if (!_ok || _p != _end)
+          return false;
+        m->addDocComment(docComment);
+        for (unsigned int i=0; i<items.size(); i++)
+          m->addItem(items[i]);
+        return true;
+      }
+    };
+
+  }
+
+  namespace {
+    /// Whether snapshots are kept in memory
+    bool residentCache = false;
+    /// Whether the main model is kept in memory
+    bool residentMain = false;
+    /// Snapshots kept in memory, by full file name
+    std::map<std::string,std::string>& residentSnapshots(void) {
+      static std::map<std::string,std::string> m;
+      return m;
+    }
+    /// Read snapshot \a buf of \a n bytes for \a fullname into \a m
+    bool readSnapshot(const char* buf, size_t n, const std::string& fullname,
+                      const char* contents, size_t size, bool parseDocComments, Model* m) {
+      CacheReader cr(buf, buf+n);
+      return cr.header(fullname, contents, size, parseDocComments) && cr.read(m);
+    }
+  }
+
+  void residentParseCache(bool b) {
+    residentCache = b;
+    if (!b)
+      clearResidentParseCache();
+  }
+
+  bool residentParseCache(void) {
+    return residentCache;
+  }
+
+  void clearResidentParseCache(void) {
+    residentSnapshots().clear();
+  }
+
+  void residentMainModel(bool b) {
+    residentMain = b;
+  }
+
+  bool residentMainModel(void) {
+    return residentMain;
+  }
+
+  bool readParseCache(const std::string& cacheDir, const std::string& fullname,
+                      const char* contents, size_t size, bool parseDocComments, Model* m) {
+    GCLock lock;
+    if (residentCache) {
+      std::map<std::string,std::string>::const_iterator it = residentSnapshots().find(fullname);
+      if (it != residentSnapshots().end()) {
+        const std::string& buf = it->second;
+        return readSnapshot(buf.c_str(), buf.size(), fullname, contents, size, parseDocComments, m);
+      }
+    }
+    if (cacheDir.empty())
+      return false;
+    std::string filename = cacheFileName(cacheDir, fullname);
+#ifdef _MSC_VER
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    if (!is.is_open())
+      return false;
+    std::string buf((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    bool ok = readSnapshot(buf.c_str(), buf.size(), fullname, contents, size, parseDocComments, m);
+    if (ok && residentCache)
+      residentSnapshots()[fullname] = buf;
+    return ok;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return false;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      return false;
+    const char* buf = static_cast<const char*>(p);
+    bool ok = readSnapshot(buf, st.st_size, fullname, contents, size, parseDocComments, m);
+    if (ok && residentCache)
+      residentSnapshots()[fullname] = std::string(buf, st.st_size);
+    munmap(p, st.st_size);
+    return ok;
+#endif
+  }
+
+  bool writeParseCache(const std::string& cacheDir, const std::string& fullname,
+                       const char* contents, size_t size, bool parseDocComments, Model* m,
+                       unsigned int first) {
+    CacheWriter cw;
+    cw.write(m, first);
+    std::string snapshot = cw.snapshot(fullname, contents, size, parseDocComments);
+    if (snapshot.empty())
+      return false;
+    if (residentCache)
+      residentSnapshots()[fullname] = snapshot;
+    if (cacheDir.empty())
+      return true;
+    return CacheWriter::save(cacheFileName(cacheDir, fullname), snapshot);
+  }
+
+}
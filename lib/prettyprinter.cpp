@@ -16,6 +16,14 @@
 #include <limits>
 #include <iomanip>
 #include <map>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include <minizinc/prettyprinter.hh>
 #include <minizinc/model.hh>
 #include <minizinc/astexception.hh>
@@ -159,11 +167,135 @@ namespace MiniZinc {
     return ret;
   }
   
+  /// Output buffer that writes directly to a file descriptor
+  class FdBuffer {
+  protected:
+    /// The file descriptor
+    int _fd;
+    /// String that output is appended to instead of the file descriptor, or NULL
+    std::string* _str;
+    /// The buffer
+    char* _buf;
+    /// Number of bytes used in the buffer
+    size_t _used;
+    /// Number of bytes written to the file descriptor
+    unsigned long long int _written;
+    /// Whether an error occurred while writing
+    bool _error;
+  public:
+    /// Size of the buffer
+    static const size_t bufSize = 1<<20;
+    FdBuffer(int fd)
+      : _fd(fd), _str(NULL), _buf(new char[bufSize]), _used(0), _written(0), _error(false) {}
+    FdBuffer(std::string& s)
+      : _fd(-1), _str(&s), _buf(new char[bufSize]), _used(0), _written(0), _error(false) {}
+    ~FdBuffer(void) {
+      flush();
+      delete[] _buf;
+    }
+    bool flush(void) {
+      if (_str) {
+        _str->append(_buf, _used);
+        _written += _used;
+        _used = 0;
+        return true;
+      }
+      size_t off = 0;
+      while (!_error && off < _used) {
+#ifdef _WIN32
+        int n = _write(_fd, _buf+off, static_cast<unsigned int>(_used-off));
+#else
+        ssize_t n = write(_fd, _buf+off, _used-off);
+#endif
+        if (n < 0) {
+          if (errno != EINTR)
+            _error = true;
+        } else {
+          off += n;
+          _written += n;
+        }
+      }
+      _used = 0;
+      return !_error;
+    }
+    unsigned long long int written(void) const { return _written+_used; }
+    void append(const char* s, size_t n) {
+      if (_used+n > bufSize) {
+        flush();
+        if (n > bufSize) {
+          // Write large strings without copying them into the buffer
+          char* buf = _buf;
+          _buf = const_cast<char*>(s);
+          _used = n;
+          flush();
+          _buf = buf;
+          return;
+        }
+      }
+      std::memcpy(_buf+_used, s, n);
+      _used += n;
+    }
+    FdBuffer& operator <<(const char* s) {
+      append(s, std::strlen(s));
+      return *this;
+    }
+    FdBuffer& operator <<(const std::string& s) {
+      append(s.c_str(), s.size());
+      return *this;
+    }
+    FdBuffer& operator <<(const ASTString& s) {
+      append(s.c_str(), s.size());
+      return *this;
+    }
+    FdBuffer& operator <<(char c) {
+      if (_used==bufSize)
+        flush();
+      _buf[_used++] = c;
+      return *this;
+    }
+    FdBuffer& operator <<(long long int v) {
+      char buf[24];
+      char* end = buf+sizeof(buf);
+      char* p = end;
+      unsigned long long int u = v < 0 ? 0ULL-static_cast<unsigned long long int>(v)
+                                       : static_cast<unsigned long long int>(v);
+      do {
+        *--p = static_cast<char>('0'+u%10);
+        u /= 10;
+      } while (u != 0);
+      if (v < 0)
+        *--p = '-';
+      append(p, end-p);
+      return *this;
+    }
+    FdBuffer& operator <<(int v) {
+      return operator <<(static_cast<long long int>(v));
+    }
+    FdBuffer& operator <<(unsigned int v) {
+      return operator <<(static_cast<long long int>(v));
+    }
+    FdBuffer& operator <<(const IntVal& v) {
+      if (v.isMinusInfinity())
+        return operator <<("-infinity");
+      else if (v.isPlusInfinity())
+        return operator <<("infinity");
+      else
+        return operator <<(v.toInt());
+    }
+    /// Only std::endl is used by the printer, which does not need a flush here
+    FdBuffer& operator <<(std::ostream& (*)(std::ostream&)) {
+      return operator <<('\n');
+    }
+  };
+
+  const size_t FdBuffer::bufSize;
+
+  template<class S>
   class PlainPrinter {
   public:
-    std::ostream& os;
+    S& os;
     bool _flatZinc;
-    PlainPrinter(std::ostream& os0, bool flatZinc) : os(os0), _flatZinc(flatZinc) {}
+    PlainPrinter(S& os0, bool flatZinc) : os(os0), _flatZinc(flatZinc) {}
 
     void p(const Type& type, const Expression* e) {
       switch (type.ti()) {
@@ -206,12 +338,13 @@ namespace MiniZinc {
         break;
       case Expression::E_FLOATLIT:
         {
-          std::ostringstream oss;
-          oss << std::setprecision(std::numeric_limits<double>::digits10+1);
-          oss << e->cast<FloatLit>()->v();
-          if (oss.str().find("e") == std::string::npos && oss.str().find(".") == std::string::npos)
-            oss << ".0";
-          os << oss.str();
+          // Same format as an ostream with precision digits10+1
+          char buf[40];
+          int n = snprintf(buf, sizeof(buf), "%.*g", std::numeric_limits<double>::digits10+1,
+                           static_cast<double>(e->cast<FloatLit>()->v()));
+          if (std::strpbrk(buf, "e.")==NULL && n+2 < static_cast<int>(sizeof(buf)))
+            std::strcpy(buf+n, ".0");
+          os << buf;
         }
         break;
       case Expression::E_SETLIT:
@@ -1902,7 +2035,7 @@ namespace MiniZinc {
   void
   Printer::print(const Expression* e) {
     if (_width==0) {
-      PlainPrinter p(_os,_flatZinc); p.p(e);
+      PlainPrinter<std::ostream> p(_os,_flatZinc); p.p(e);
     } else {
       init();
       Document* d = expressionToDocument(e);
@@ -1913,7 +2046,7 @@ namespace MiniZinc {
   void
   Printer::print(const Item* i) {
     if (_width==0) {
-      PlainPrinter p(_os,_flatZinc); p.p(i);
+      PlainPrinter<std::ostream> p(_os,_flatZinc); p.p(i);
     } else {
       init();
       p(i);
@@ -1922,7 +2055,7 @@ namespace MiniZinc {
   void
   Printer::print(const Model* m) {
     if (_width==0) {
-      PlainPrinter p(_os,_flatZinc);
+      PlainPrinter<std::ostream> p(_os,_flatZinc);
       for (unsigned int i = 0; i < m->size(); i++) {
         p.p((*m)[i]);
       }
@@ -1934,6 +2067,37 @@ namespace MiniZinc {
     }
   }
 
+  FdPrinter::FdPrinter(int fd, bool flatZinc)
+  : _out(new FdBuffer(fd)), _flatZinc(flatZinc) {}
+  FdPrinter::FdPrinter(std::string& s, bool flatZinc)
+  : _out(new FdBuffer(s)), _flatZinc(flatZinc) {}
+  FdPrinter::~FdPrinter(void) {
+    delete _out;
+  }
+  void
+  FdPrinter::print(const Expression* e) {
+    PlainPrinter<FdBuffer> p(*_out,_flatZinc); p.p(e);
+  }
+  void
+  FdPrinter::print(const Item* i) {
+    PlainPrinter<FdBuffer> p(*_out,_flatZinc); p.p(i);
+  }
+  void
+  FdPrinter::print(const Model* m) {
+    PlainPrinter<FdBuffer> p(*_out,_flatZinc);
+    for (unsigned int i = 0; i < m->size(); i++) {
+      p.p((*m)[i]);
+    }
+  }
+  bool
+  FdPrinter::flush(void) {
+    return _out->flush();
+  }
+  unsigned long long int
+  FdPrinter::bytesWritten(void) const {
+    return _out->written();
+  }
+
 }
 
 void debugprint(MiniZinc::Expression* e) {
@@ -0,0 +1,179 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/profiler.hh>
+#include <minizinc/statistics.hh>
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace MiniZinc {
+
+  namespace {
+    /// Order entries by decreasing self time
+    class CmpSelfTime {
+    public:
+      bool operator()(const Profiler::Entry* x, const Profiler::Entry* y) const {
+        if (x->self.time != y->self.time)
+          return x->self.time > y->self.time;
+        return x->name < y->name;
+      }
+    };
+
+    /// Return entries of \a m, most expensive first
+    std::vector<const Profiler::Entry*> sorted(const std::map<std::string,Profiler::Entry>& m) {
+      std::vector<const Profiler::Entry*> v;
+      for (std::map<std::string,Profiler::Entry>::const_iterator it = m.begin(); it != m.end(); ++it)
+        v.push_back(&it->second);
+      std::sort(v.begin(), v.end(), CmpSelfTime());
+      return v;
+    }
+
+    /// Print table of the first \a n entries of \a v
+    void printTable(std::ostream& os, const std::vector<const Profiler::Entry*>& v,
+                    unsigned int n, const std::string& title) {
+      os << title << " (" << std::min(static_cast<size_t>(n),v.size()) << " of " << v.size()
+         << ", by self time):" << std::endl;
+      os << std::setw(10) << "self ms" << std::setw(10) << "total ms" << std::setw(10) << "count"
+         << std::setw(10) << "vars" << std::setw(12) << "constraints" << std::setw(10) << "Kbytes"
+         << "  " << "name" << std::endl;
+      for (unsigned int i=0; i<v.size() && i<n; i++) {
+        const Profiler::Entry* e = v[i];
+        os << std::setw(10) << e->self.time << std::setw(10) << e->total.time
+           << std::setw(10) << e->count << std::setw(10) << e->total.vars
+           << std::setw(12) << e->total.constraints << std::setw(10) << e->total.bytes/1024
+           << "  " << e->name << std::endl;
+      }
+    }
+
+    /// Print entries \a v as a JSON array
+    void printJSONArray(std::ostream& os, const std::vector<const Profiler::Entry*>& v) {
+      os << "[";
+      for (unsigned int i=0; i<v.size(); i++) {
+        const Profiler::Entry* e = v[i];
+        os << (i==0 ? "\n" : ",\n") << "    {\"name\": ";
+        printJSONString(os, e->name);
+        os << ", \"count\": " << e->count
+           << ", \"time\": " << e->total.time << ", \"self_time\": " << e->self.time
+           << ", \"vars\": " << e->total.vars << ", \"self_vars\": " << e->self.vars
+           << ", \"constraints\": " << e->total.constraints
+           << ", \"self_constraints\": " << e->self.constraints
+           << ", \"bytes\": " << e->total.bytes << ", \"self_bytes\": " << e->self.bytes << "}";
+      }
+      os << (v.empty() ? "]" : "\n  ]");
+    }
+  }
+
+  Profiler::Profiler(void) : _vars(0), _constraints(0) {}
+
+  Profiler::Cost
+  Profiler::counters(void) const {
+    Cost c;
+    c.vars = _vars;
+    c.constraints = _constraints;
+    c.bytes = GC::allocated();
+    return c;
+  }
+
+  void
+  Profiler::enter(const Location& loc, const ASTString& pred) {
+    std::ostringstream oss;
+    if (loc.filename.size()==0)
+      oss << "(introduced)";
+    else
+      oss << loc.filename << ":" << loc.first_line;
+    Frame f;
+    f.loc = &_locations[oss.str()];
+    if (f.loc->count==0)
+      f.loc->name = oss.str();
+    f.loc->count++;
+    f.loc->active++;
+    if (pred.size() > 0) {
+      f.pred = &_predicates[pred.str()];
+      if (f.pred->count==0)
+        f.pred->name = pred.str();
+      f.pred->count++;
+      f.pred->active++;
+    } else {
+      f.pred = NULL;
+    }
+    f.start = counters();
+    _stack.push_back(f);
+    _stack.back().timer.reset();
+  }
+
+  void
+  Profiler::exit(void) {
+    assert(!_stack.empty());
+    Frame& f = _stack.back();
+    Cost c = counters();
+    c -= f.start;
+    c.time = f.timer.ms();
+    Cost self = c;
+    self -= f.children;
+    f.loc->self += self;
+    if (--f.loc->active == 0)
+      f.loc->total += c;
+    if (f.pred) {
+      f.pred->self += self;
+      if (--f.pred->active == 0)
+        f.pred->total += c;
+    }
+    _stack.pop_back();
+    if (!_stack.empty())
+      _stack.back().children += c;
+  }
+
+  void
+  Profiler::addItem(Item* i) {
+    if (i->isa<VarDeclI>())
+      _vars++;
+    else if (i->isa<ConstraintI>())
+      _constraints++;
+  }
+
+  std::vector<const Profiler::Entry*>
+  Profiler::locations(void) const {
+    return sorted(_locations);
+  }
+
+  std::vector<const Profiler::Entry*>
+  Profiler::predicates(void) const {
+    return sorted(_predicates);
+  }
+
+  void
+  Profiler::print(std::ostream& os, unsigned int n) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    printTable(os, locations(), n, "Flattening profile by source location");
+    printTable(os, predicates(), n, "Flattening profile by predicate");
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+  void
+  Profiler::printJSON(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "{\n  \"locations\": ";
+    printJSONArray(os, locations());
+    os << ",\n  \"predicates\": ";
+    printJSONArray(os, predicates());
+    os << "\n}\n";
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+}
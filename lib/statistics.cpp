@@ -0,0 +1,108 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/statistics.hh>
+
+#include <iomanip>
+
+namespace MiniZinc {
+
+  CompilerStatistics::CompilerStatistics(void)
+    : time(0.0), cse_lookups(0), cse_hits(0), fn_cache_hits(0), fn_cache_misses(0),
+      gc_max_mem(0), gc_used_mem(0), gc_allocated(0), gc_collections(0),
+      gc_pause_time(0.0), gc_max_pause_time(0.0) {}
+
+  void
+  CompilerStatistics::phase(const std::string& name, double ms) {
+    phases.push_back(std::make_pair(name,ms));
+  }
+
+  void
+  CompilerStatistics::collect(Env& env) {
+    flat = statistics(env);
+    cse_lookups = env.cseLookups();
+    cse_hits = env.cseHits();
+    fn_cache_hits = env.model()->fnCacheHits();
+    fn_cache_misses = env.model()->fnCacheMisses();
+  }
+
+  void
+  CompilerStatistics::collectGC(void) {
+    gc_max_mem = GC::maxMem();
+    gc_used_mem = GC::usedMem();
+    gc_allocated = GC::allocated();
+    gc_collections = GC::collections();
+    gc_pause_time = GC::pauseTime();
+    gc_max_pause_time = GC::maxPauseTime();
+  }
+
+  double
+  CompilerStatistics::cseHitRate(void) const {
+    return cse_lookups==0 ? 0.0 : static_cast<double>(cse_hits)/cse_lookups;
+  }
+
+  void
+  CompilerStatistics::printJSON(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "{\n  \"time\": " << time << ",\n  \"phases\": {";
+    for (unsigned int i=0; i<phases.size(); i++) {
+      os << (i==0 ? "\n    " : ",\n    ");
+      printJSONString(os, phases[i].first);
+      os << ": " << phases[i].second;
+    }
+    os << (phases.empty() ? "}" : "\n  }");
+    os << ",\n  \"variables\": {\"bool\": " << flat.n_bool_vars << ", \"int\": " << flat.n_int_vars
+       << ", \"float\": " << flat.n_float_vars << ", \"set\": " << flat.n_set_vars << "}";
+    os << ",\n  \"constraints\": {\"bool\": " << flat.n_bool_ct << ", \"int\": " << flat.n_int_ct
+       << ", \"float\": " << flat.n_float_ct << ", \"set\": " << flat.n_set_ct << "}";
+    os << ",\n  \"constraints_by_predicate\": {";
+    for (std::map<std::string,int>::const_iterator it = flat.n_pred_ct.begin();
+         it != flat.n_pred_ct.end(); ++it) {
+      os << (it==flat.n_pred_ct.begin() ? "\n    " : ",\n    ");
+      printJSONString(os, it->first);
+      os << ": " << it->second;
+    }
+    os << (flat.n_pred_ct.empty() ? "}" : "\n  }");
+    os << ",\n  \"cse\": {\"lookups\": " << cse_lookups << ", \"hits\": " << cse_hits
+       << ", \"hit_rate\": " << cseHitRate() << "}";
+    os << ",\n  \"overload_cache\": {\"hits\": " << fn_cache_hits
+       << ", \"misses\": " << fn_cache_misses << "}";
+    os << ",\n  \"gc\": {\"max_mem\": " << gc_max_mem << ", \"used_mem\": " << gc_used_mem
+       << ", \"allocated\": " << gc_allocated << ", \"collections\": " << gc_collections
+       << ", \"pause_time\": " << gc_pause_time << ", \"max_pause_time\": " << gc_max_pause_time << "}";
+    os << "\n}\n";
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+  void
+  printJSONString(std::ostream& os, const std::string& s) {
+    os << "\"";
+    for (unsigned int i=0; i<s.size(); i++) {
+      switch (s[i]) {
+        case '"': os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        case '\n': os << "\\n"; break;
+        case '\t': os << "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(s[i]) < 0x20)
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << static_cast<int>(s[i]) << std::dec << std::setfill(' ');
+          else
+            os << s[i];
+      }
+    }
+    os << "\"";
+  }
+
+}
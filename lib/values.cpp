@@ -11,16 +11,209 @@
 
 #include <minizinc/values.hh>
 #include <climits>
+#include <algorithm>
 
 namespace MiniZinc {
   
   const IntVal IntVal::minint(void) { return IntVal(INT_MIN); }
   const IntVal IntVal::maxint(void) { return IntVal(INT_MAX); }
-  const IntVal IntVal::infinity(void) { return IntVal(1,true); }
+  const IntVal IntVal::infinity(void) { return IntVal(PLUS_INF,Raw()); }
  
-  IntSetVal::IntSetVal(IntVal m, IntVal n) : ASTChunk(sizeof(Range)) {
-    get(0).min = m;
-    get(0).max = n;
+  size_t
+  IntSetVal::hash(const Range* r, int n) {
+    size_t h = static_cast<size_t>(n);
+    for (int i=0; i<n; i++) {
+      h ^= r[i].min.hash() + 0x9e3779b9 + (h << 6) + (h >> 2);
+      h ^= r[i].max.hash() + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+    return h;
   }
 
-}
\ No newline at end of file
+  namespace {
+    /// Test if an interned set consists of given ranges
+    class IntSetEq {
+    public:
+      const IntSetVal::Range* r;
+      int n;
+      IntSetEq(const IntSetVal::Range* r0, int n0) : r(r0), n(n0) {}
+      bool operator()(const IntSetVal* s) const {
+        if (s->size() != n)
+          return false;
+        for (int i=0; i<n; i++) {
+          if (s->min(i) != r[i].min || s->max(i) != r[i].max)
+            return false;
+        }
+        return true;
+      }
+    };
+  }
+
+  IntSetVal*
+  IntSetVal::intern(const Range* r, int n) {
+    size_t h = hash(r,n);
+    if (IntSetVal* s = GC::intSets().find<IntSetVal>(h, IntSetEq(r,n)))
+      return s;
+    IntSetVal* s = static_cast<IntSetVal*>(ASTChunk::alloc(sizeof(Range)*n));
+    new (s) IntSetVal(r,n);
+    GC::intSets().add(s,h);
+    return s;
+  }
+
+  IntSetVal*
+  IntSetVal::a(const std::vector<IntVal>& s) {
+    if (s.size()==0)
+      return a();
+    IntVal mi = s[0];
+    IntVal ma = s[0];
+    bool sorted = true;
+    for (unsigned int i=1; i<s.size(); i++) {
+      if (s[i] < s[i-1])
+        sorted = false;
+      mi = std::min(mi,s[i]);
+      ma = std::max(ma,s[i]);
+    }
+    RangeBuffer b;
+    if (sorted) {
+      for (unsigned int i=0; i<s.size(); i++)
+        b.merge(s[i],s[i]);
+      return b.a();
+    }
+    if (mi.isFinite() && ma.isFinite()) {
+      unsigned long long int span =
+        static_cast<unsigned long long int>(ma.toInt())-static_cast<unsigned long long int>(mi.toInt());
+      if (span/64 < s.size()) {
+        // Dense set, collect elements in a bit set instead of sorting
+        std::vector<unsigned long long int> bits(span/64+1, 0);
+        for (unsigned int i=0; i<s.size(); i++) {
+          unsigned long long int k =
+            static_cast<unsigned long long int>(s[i].toInt())-static_cast<unsigned long long int>(mi.toInt());
+          bits[k/64] |= 1ULL << (k%64);
+        }
+        for (unsigned long long int k=0; k<=span; k++) {
+          if (bits[k/64]==0) {
+            k |= 63;
+            continue;
+          }
+          if (bits[k/64] & (1ULL << (k%64))) {
+            IntVal v = mi.toInt()+static_cast<long long int>(k);
+            b.merge(v,v);
+          }
+        }
+        return b.a();
+      }
+    }
+    std::vector<IntVal> sv = s;
+    std::sort(sv.begin(),sv.end());
+    for (unsigned int i=0; i<sv.size(); i++)
+      b.merge(sv[i],sv[i]);
+    return b.a();
+  }
+
+  IntSetVal*
+  IntSetVal::unite(IntSetVal* s0, IntSetVal* s1) {
+    if (s0==s1 || s1->size()==0)
+      return s0;
+    if (s0->size()==0)
+      return s1;
+    RangeBuffer b;
+    int i=0;
+    int j=0;
+    while (i<s0->size() || j<s1->size()) {
+      if (j==s1->size() || (i<s0->size() && s0->min(i) <= s1->min(j))) {
+        b.merge(s0->min(i),s0->max(i));
+        i++;
+      } else {
+        b.merge(s1->min(j),s1->max(j));
+        j++;
+      }
+    }
+    return b.a();
+  }
+
+  IntSetVal*
+  IntSetVal::intersect(IntSetVal* s0, IntSetVal* s1) {
+    if (s0==s1)
+      return s0;
+    RangeBuffer b;
+    int i=0;
+    int j=0;
+    while (i<s0->size() && j<s1->size()) {
+      IntVal mi = std::max(s0->min(i),s1->min(j));
+      IntVal ma = std::min(s0->max(i),s1->max(j));
+      if (mi <= ma)
+        b.push(mi,ma);
+      if (s0->max(i) < s1->max(j))
+        i++;
+      else
+        j++;
+    }
+    return b.a();
+  }
+
+  IntSetVal*
+  IntSetVal::diff(IntSetVal* s0, IntSetVal* s1) {
+    if (s0==s1)
+      return a();
+    if (s1->size()==0)
+      return s0;
+    RangeBuffer b;
+    int j=0;
+    for (int i=0; i<s0->size(); i++) {
+      IntVal mi = s0->min(i);
+      IntVal ma = s0->max(i);
+      while (j<s1->size() && s1->max(j) < mi)
+        j++;
+      bool covered = false;
+      while (j<s1->size() && s1->min(j) <= ma) {
+        if (s1->min(j) > mi)
+          b.push(mi,s1->min(j).minus(1));
+        if (s1->max(j) >= ma) {
+          covered = true;
+          break;
+        }
+        mi = s1->max(j).plus(1);
+        j++;
+      }
+      if (!covered)
+        b.push(mi,ma);
+    }
+    return b.a();
+  }
+
+  IntSetVal*
+  IntSetVal::symdiff(IntSetVal* s0, IntSetVal* s1) {
+    return unite(diff(s0,s1),diff(s1,s0));
+  }
+
+  IntSetVal*
+  IntSetVal::intersect(IntSetVal* s, IntVal m, IntVal n) {
+    if (m > n)
+      return a();
+    if (s->size()==0 || (m <= s->min() && s->max() <= n))
+      return s;
+    RangeBuffer b;
+    for (int i=s->find(m); i<s->size() && s->min(i) <= n; i++)
+      b.push(std::max(s->min(i),m),std::min(s->max(i),n));
+    return b.a();
+  }
+
+  IntSetVal*
+  IntSetVal::remove(IntSetVal* s, IntVal v) {
+    int k = s->find(v);
+    if (k==s->size() || v < s->min(k))
+      return s;
+    RangeBuffer b;
+    for (int i=0; i<s->size(); i++) {
+      if (i==k) {
+        if (s->min(i) < v)
+          b.push(s->min(i),v.minus(1));
+        if (v < s->max(i))
+          b.push(v.plus(1),s->max(i));
+      } else {
+        b.push(s->min(i),s->max(i));
+      }
+    }
+    return b.a();
+  }
+
+}
@@ -17,9 +17,22 @@
 #include <fstream>
 #include <iomanip>
 #include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <csignal>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
 
 #include <minizinc/model.hh>
 #include <minizinc/parser.hh>
+#include <minizinc/parser_cache.hh>
 #include <minizinc/prettyprinter.hh>
 #include <minizinc/typecheck.hh>
 #include <minizinc/astexception.hh>
@@ -29,233 +42,373 @@
 #include <minizinc/builtins.hh>
 #include <minizinc/file_utils.hh>
 #include <minizinc/timer.hh>
+#include <minizinc/profiler.hh>
+#include <minizinc/statistics.hh>
+#include <minizinc/dependencies.hh>
 
 using namespace MiniZinc;
 using namespace std;
 
-std::string stoptime(Timer& start) {
+std::string stoptime(double ms) {
   std::ostringstream oss;
-  oss << std::setprecision(0) << std::fixed << start.ms() << " ms";
-  start.reset();
+  oss << std::setprecision(0) << std::fixed << ms << " ms";
   return oss.str();
 }
 
+std::string throughput(double ms, unsigned long long int bytes) {
+  std::ostringstream oss;
+  oss << std::setprecision(0) << std::fixed << ms << " ms, "
+      << std::setprecision(1) << (bytes/(1024.0*1024.0)) << " Mbytes";
+  if (ms > 0)
+    oss << " at " << (bytes/(1024.0*1024.0))/(ms/1000.0) << " Mbytes/s";
+  return oss.str();
+}
+
+/// Record time since \a start as phase \a name in \a stats, and restart \a start
+double endphase(CompilerStatistics& stats, const std::string& name, Timer& start) {
+  double ms = start.ms();
+  stats.phase(name, ms);
+  start.reset();
+  return ms;
+}
+
+/// Open \a filename for writing, or standard output if \a filename is empty
+int openOutput(const std::string& filename) {
+  if (filename.empty()) {
+    std::cout.flush();
+    return 1;
+  }
+#ifdef _WIN32
+  return _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC, _S_IREAD | _S_IWRITE);
+#else
+  return open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+}
+
+void closeOutput(int fd) {
+  if (fd != 1) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+  }
+}
+
 bool beginswith(string s, string t) {
   return s.compare(0, t.length(), t)==0;
 }
 
-int main(int argc, char** argv) {
+/// Options and input of a compilation
+class Compilation {
+public:
   string filename;
   vector<string> datafiles;
-  vector<string> includePaths;  
-  bool flag_ignoreStdlib = false;
-  bool flag_typecheck = true;
-  bool flag_verbose = false;
-  bool flag_newfzn = false;
-  bool flag_optimize = true;
-  bool flag_werror = false;
-  bool flag_statistics = false;
-  bool flag_stdinInput = false;
-  
-  Timer starttime;
-  Timer lasttime;
-  
+  vector<string> includePaths;
+  bool flag_ignoreStdlib;
+  bool flag_typecheck;
+  bool flag_verbose;
+  bool flag_newfzn;
+  bool flag_optimize;
+  bool flag_werror;
+  bool flag_statistics;
+  bool flag_stdinInput;
+  bool flag_gc_incremental;
+  int flag_gc_mark_threads;
+  bool flag_profile;
+  std::string flag_profile_json;
+  std::string flag_statistics_json;
+  bool flag_version;
+  bool flag_server;
+  std::string flag_server_socket;
+  std::string flag_batch;
+  int flag_jobs;
+  std::string flag_dependencies;
+
   string std_lib_dir;
-  if (char* MZNSTDLIBDIR = getenv("MZN_STDLIB_DIR")) {
-    std_lib_dir = string(MZNSTDLIBDIR);
-  }
   string globals_dir;
-  
-  bool flag_no_output_ozn = false;
+  string stdlib_cache_dir;
+
+  bool flag_no_output_ozn;
   string flag_output_base;
   string flag_output_fzn;
   string flag_output_ozn;
-  bool flag_output_fzn_stdout = false;
-  bool flag_output_ozn_stdout = false;
-  bool flag_instance_check_only = false;
+  bool flag_output_fzn_stdout;
+  bool flag_output_ozn_stdout;
+  bool flag_instance_check_only;
   FlatteningOptions fopts;
 
-  if (argc < 2)
-    goto error;
-  
-  for (int i=1; i<argc; i++) {
-    if (string(argv[i])==string("-h") || string(argv[i])==string("--help"))
-        goto error;
-    if (string(argv[i])==string("--version")) {
-      std::cout << "NICTA MiniZinc to FlatZinc converter, version "
-        << MZN_VERSION_MAJOR << "." << MZN_VERSION_MINOR << "." << MZN_VERSION_PATCH << std::endl;
-      std::cout << "Copyright (C) 2014, 2015 Monash University and NICTA" << std::endl;
-      std::exit(EXIT_SUCCESS);
+  /// Model text, if the model is read from standard input
+  std::string modelText;
+
+  /// Constructor, initialising the options from their defaults and the environment
+  Compilation(void);
+  /// Process command line arguments \a args, return false if they are invalid
+  bool processArgs(const vector<string>& args, std::ostream& err);
+  /// Compile, writing messages to \a err
+  /// If \a fzn and \a ozn are not NULL, the output is stored in them instead
+  /// of the output files. Returns the exit status.
+  int run(std::ostream& err, std::string* fzn = NULL, std::string* ozn = NULL);
+protected:
+  /// Return the options that the flat model depends on, for its Dependencies
+  std::string dependencyOptions(void) const;
+  /// Typecheck, flatten and print the parsed model \a m
+  int compile(Model* m, std::ostream& err, std::string* fzn, std::string* ozn,
+              CompilerStatistics& cstats, Timer& lasttime);
+  /// Print \a m to \a s if not NULL, otherwise to \a file (or standard output if \a toStdout)
+  bool printModel(Model* m, const char* kind, const char* phase, std::string* s,
+                  bool toStdout, const std::string& file,
+                  std::ostream& err, CompilerStatistics& cstats, Timer& lasttime);
+};
+
+Compilation::Compilation(void)
+  : flag_ignoreStdlib(false), flag_typecheck(true), flag_verbose(false), flag_newfzn(false),
+    flag_optimize(true), flag_werror(false), flag_statistics(false), flag_stdinInput(false),
+    flag_gc_incremental(false), flag_gc_mark_threads(1), flag_profile(false),
+    flag_version(false), flag_server(false), flag_jobs(1),
+    flag_no_output_ozn(false), flag_output_fzn_stdout(false), flag_output_ozn_stdout(false),
+    flag_instance_check_only(false) {
+  if (char* MZNSTDLIBDIR = getenv("MZN_STDLIB_DIR")) {
+    std_lib_dir = string(MZNSTDLIBDIR);
+  }
+  if (char* MZNSTDLIBCACHE = getenv("MZN_STDLIB_CACHE")) {
+    stdlib_cache_dir = string(MZNSTDLIBCACHE);
+  }
+}
+
+bool
+Compilation::processArgs(const vector<string>& args, std::ostream& err) {
+  for (unsigned int i=0; i<args.size(); i++) {
+    if (args[i]==string("-h") || args[i]==string("--help"))
+        return false;
+    if (args[i]==string("--version")) {
+      flag_version = true;
+      return true;
     }
-    if (beginswith(string(argv[i]),"-I")) {
-      string include(argv[i]);
+    if (beginswith(args[i],"-I")) {
+      string include(args[i]);
       if (include.length() > 2) {
         includePaths.push_back(include.substr(2)+string("/"));
       } else {
         i++;
-        if (i==argc) {
-          goto error;
+        if (i==args.size()) {
+          return false;
         }
-        includePaths.push_back(argv[i]+string("/"));
+        includePaths.push_back(args[i]+string("/"));
       }
-    } else if (string(argv[i])==string("--ignore-stdlib")) {
+    } else if (args[i]==string("--ignore-stdlib")) {
       flag_ignoreStdlib = true;
-    } else if (string(argv[i])==string("--no-typecheck")) {
+    } else if (args[i]==string("--no-typecheck")) {
       flag_typecheck = false;
-    } else if (string(argv[i])==string("--instance-check-only")) {
+    } else if (args[i]==string("--instance-check-only")) {
       flag_instance_check_only = true;
-    } else if (string(argv[i])==string("-v") || string(argv[i])==string("--verbose")) {
+    } else if (args[i]==string("-v") || args[i]==string("--verbose")) {
       flag_verbose = true;
-    } else if (string(argv[i])==string("--newfzn")) {
+    } else if (args[i]==string("--newfzn")) {
       flag_newfzn = true;
-    } else if (string(argv[i])==string("--no-optimize") || string(argv[i])==string("--no-optimise")) {
+    } else if (args[i]==string("--no-optimize") || args[i]==string("--no-optimise")) {
       flag_optimize = false;
-    } else if (string(argv[i])==string("--no-output-ozn") ||
-               string(argv[i])==string("-O-")) {
+    } else if (args[i]==string("--no-output-ozn") ||
+               args[i]==string("-O-")) {
       flag_no_output_ozn = true;
-    } else if (string(argv[i])=="--output-base") {
+    } else if (args[i]=="--output-base") {
       i++;
-      if (i==argc)
-        goto error;
-      flag_output_base = argv[i];
-    } else if (beginswith(string(argv[i]),"-o")) {
-        string filename(argv[i]);
+      if (i==args.size())
+        return false;
+      flag_output_base = args[i];
+    } else if (beginswith(args[i],"-o")) {
+        string filename(args[i]);
         if (filename.length() > 2) {
           flag_output_fzn = filename.substr(2);
         } else {
           i++;
-          if (i==argc) {
-            goto error;
+          if (i==args.size()) {
+            return false;
           }
-          flag_output_fzn = argv[i];
+          flag_output_fzn = args[i];
         }
-    } else if (string(argv[i])=="--output-to-file" ||
-               string(argv[i])=="--output-fzn-to-file") {
+    } else if (args[i]=="--output-to-file" ||
+               args[i]=="--output-fzn-to-file") {
       i++;
-      if (i==argc)
-        goto error;
-      flag_output_fzn = argv[i];
-    } else if (string(argv[i])=="--output-ozn-to-file") {
+      if (i==args.size())
+        return false;
+      flag_output_fzn = args[i];
+    } else if (args[i]=="--output-ozn-to-file") {
       i++;
-      if (i==argc)
-        goto error;
-      flag_output_ozn = argv[i];
-    } else if (string(argv[i])=="--output-to-stdout" ||
-               string(argv[i])=="--output-fzn-to-stdout") {
+      if (i==args.size())
+        return false;
+      flag_output_ozn = args[i];
+    } else if (args[i]=="--output-to-stdout" ||
+               args[i]=="--output-fzn-to-stdout") {
       flag_output_fzn_stdout = true;
-    } else if (string(argv[i])=="--output-ozn-to-stdout") {
+    } else if (args[i]=="--output-ozn-to-stdout") {
       flag_output_ozn_stdout = true;
-    } else if (string(argv[i])=="-" || string(argv[i])=="--input-from-stdin") {
+    } else if (args[i]=="-" || args[i]=="--input-from-stdin") {
       if (datafiles.size() > 0 || filename != "")
-        goto error;
+        return false;
       flag_stdinInput = true;
-    } else if (beginswith(string(argv[i]),"-d")) {
+    } else if (beginswith(args[i],"-d")) {
       if (flag_stdinInput)
-        goto error;
-      string filename(argv[i]);
+        return false;
+      string filename(args[i]);
       string datafile;
       if (filename.length() > 2) {
         datafile = filename.substr(2);
       } else {
         i++;
-        if (i==argc) {
-          goto error;
+        if (i==args.size()) {
+          return false;
         }
-        datafile = argv[i];
+        datafile = args[i];
       }
       if (datafile.length()<=4 ||
           datafile.substr(datafile.length()-4,string::npos) != ".dzn")
-        goto error;
+        return false;
       datafiles.push_back(datafile);
-    } else if (string(argv[i])=="--data") {
+    } else if (args[i]=="--data") {
       if (flag_stdinInput)
-        goto error;
+        return false;
       i++;
-      if (i==argc) {
-        goto error;
+      if (i==args.size()) {
+        return false;
       }
-      string datafile = argv[i];
+      string datafile = args[i];
       if (datafile.length()<=4 ||
           datafile.substr(datafile.length()-4,string::npos) != ".dzn")
-        goto error;
+        return false;
       datafiles.push_back(datafile);
-    } else if (string(argv[i])=="--stdlib-dir") {
+    } else if (args[i]=="--stdlib-dir") {
       i++;
-      if (i==argc)
-        goto error;
-      std_lib_dir = argv[i];
-    } else if (beginswith(string(argv[i]),"-G")) {
-      string filename(argv[i]);
+      if (i==args.size())
+        return false;
+      std_lib_dir = args[i];
+    } else if (args[i]=="--stdlib-cache") {
+      i++;
+      if (i==args.size())
+        return false;
+      stdlib_cache_dir = args[i];
+    } else if (beginswith(args[i],"-G")) {
+      string filename(args[i]);
       if (filename.length() > 2) {
         globals_dir = filename.substr(2);
       } else {
         i++;
-        if (i==argc) {
-          goto error;
+        if (i==args.size()) {
+          return false;
         }
-        globals_dir = argv[i];
+        globals_dir = args[i];
       }
-    } else if (beginswith(string(argv[i]),"-D")) {
+    } else if (beginswith(args[i],"-D")) {
       if (flag_stdinInput)
-        goto error;
-      string cmddata(argv[i]);
+        return false;
+      string cmddata(args[i]);
       if (cmddata.length() > 2) {
         datafiles.push_back("cmd:/"+cmddata.substr(2));
       } else {
         i++;
-        if (i==argc) {
-          goto error;
+        if (i==args.size()) {
+          return false;
         }
-        datafiles.push_back("cmd:/"+string(argv[i]));
+        datafiles.push_back("cmd:/"+args[i]);
       }
-    } else if (string(argv[i])=="--cmdline-data") {
+    } else if (args[i]=="--cmdline-data") {
       if (flag_stdinInput)
-        goto error;
+        return false;
       i++;
-      if (i==argc) {
-        goto error;
+      if (i==args.size()) {
+        return false;
       }
-      datafiles.push_back("cmd:/"+string(argv[i]));
-    } else if (string(argv[i])=="--globals-dir" ||
-               string(argv[i])=="--mzn-globals-dir") {
+      datafiles.push_back("cmd:/"+args[i]);
+    } else if (args[i]=="--globals-dir" ||
+               args[i]=="--mzn-globals-dir") {
       i++;
-      if (i==argc)
-        goto error;
-      globals_dir = argv[i];
-    } else if (string(argv[i])=="-Werror") {
+      if (i==args.size())
+        return false;
+      globals_dir = args[i];
+    } else if (args[i]=="-Werror") {
       flag_werror = true;
-    } else if (string(argv[i])=="-s" || string(argv[i])=="--statistics") {
+    } else if (args[i]=="-s" || args[i]=="--statistics") {
       flag_statistics = true;
+    } else if (args[i]=="--statistics-json") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_statistics_json = args[i];
+    } else if (args[i]=="--gc-incremental") {
+      flag_gc_incremental = true;
+    } else if (args[i]=="--profile") {
+      flag_profile = true;
+    } else if (args[i]=="--profile-json") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_profile = true;
+      flag_profile_json = args[i];
+    } else if (args[i]=="--server") {
+      flag_server = true;
+    } else if (args[i]=="--server-socket") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_server = true;
+      flag_server_socket = args[i];
+    } else if (args[i]=="--dependencies") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_dependencies = args[i];
+    } else if (args[i]=="--batch") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_batch = args[i];
+    } else if (args[i]=="--jobs") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_jobs = atoi(args[i].c_str());
+      if (flag_jobs < 1)
+        return false;
+    } else if (args[i]=="--gc-mark-threads") {
+      i++;
+      if (i==args.size())
+        return false;
+      flag_gc_mark_threads = atoi(args[i].c_str());
+      if (flag_gc_mark_threads < 1)
+        return false;
     } else {
       if (flag_stdinInput)
-        goto error;
-      std::string input_file(argv[i]);
+        return false;
+      std::string input_file(args[i]);
       if (input_file.length()<=4) {
-        std::cerr << "Error: cannot handle file " << input_file << "." << std::endl;
-        goto error;
+        err << "Error: cannot handle file " << input_file << "." << std::endl;
+        return false;
       }
       std::string extension = input_file.substr(input_file.length()-4,string::npos);
       if (extension == ".mzn") {
         if (filename=="") {
           filename = input_file;
         } else {
-          std::cerr << "Error: Multiple .mzn files given." << std::endl;
-          goto error;
+          err << "Error: Multiple .mzn files given." << std::endl;
+          return false;
         }
       } else if (extension == ".dzn") {
         datafiles.push_back(input_file);
       } else {
-        std::cerr << "Error: cannot handle file extension " << extension << "." << std::endl;
-        goto error;
+        err << "Error: cannot handle file extension " << extension << "." << std::endl;
+        return false;
       }
     }
   }
+  return true;
+}
+
+int
+Compilation::run(std::ostream& err, std::string* fzn, std::string* ozn) {
+  Timer starttime;
+  Timer lasttime;
+  CompilerStatistics cstats;
 
-  if (filename=="" && !flag_stdinInput) {
-    std::cerr << "Error: no model file given." << std::endl;
-    goto error;
-  }
-  
   if (std_lib_dir=="") {
     std::string mypath = FileUtils::progpath();
     if (!mypath.empty()) {
@@ -270,10 +423,10 @@ int main(int argc, char** argv) {
   }
   
   if (std_lib_dir=="") {
-    std::cerr << "Error: unknown minizinc standard library directory.\n"
-              << "Specify --stdlib-dir on the command line or set the\n"
-              << "MZN_STDLIB_DIR environment variable.\n";
-    std::exit(EXIT_FAILURE);
+    err << "Error: unknown minizinc standard library directory.\n"
+        << "Specify --stdlib-dir on the command line or set the\n"
+        << "MZN_STDLIB_DIR environment variable.\n";
+    return EXIT_FAILURE;
   }
   
   if (globals_dir!="") {
@@ -283,10 +436,14 @@ int main(int argc, char** argv) {
   
   for (unsigned int i=0; i<includePaths.size(); i++) {
     if (!FileUtils::directory_exists(includePaths[i])) {
-      std::cerr << "Cannot access include directory " << includePaths[i] << "\n";
-      std::exit(EXIT_FAILURE);
+      err << "Cannot access include directory " << includePaths[i] << "\n";
+      return EXIT_FAILURE;
     }
   }
+  if (stdlib_cache_dir!="" && !FileUtils::directory_exists(stdlib_cache_dir)) {
+    err << "Cannot access cache directory " << stdlib_cache_dir << "\n";
+    return EXIT_FAILURE;
+  }
   
   if (flag_output_base == "") {
     if (flag_stdinInput) {
@@ -302,233 +459,784 @@ int main(int argc, char** argv) {
     flag_output_ozn = flag_output_base+".ozn";
   }
 
+  if (flag_gc_incremental) {
+    GC::mode(GC::GCM_INCREMENTAL);
+  }
+  GC::markThreads(flag_gc_mark_threads);
+
   {
     std::stringstream errstream;
     if (flag_verbose) {
       if (flag_stdinInput) {
-        std::cerr << "Parsing standard input" << std::endl;
+        err << "Parsing standard input" << std::endl;
       } else {
-        std::cerr << "Parsing '" << filename << "'" << std::endl;
+        err << "Parsing '" << filename << "'" << std::endl;
       }
     }
     Model* m;
     if (flag_stdinInput) {
       filename = "stdin";
-      std::string input = std::string(istreambuf_iterator<char>(std::cin), istreambuf_iterator<char>());
-      m = parseFromString(input, filename, includePaths, flag_ignoreStdlib, false, flag_verbose, errstream);
+      m = parseFromString(modelText, filename, includePaths, flag_ignoreStdlib, false, flag_verbose, errstream,
+                          stdlib_cache_dir);
     } else {
-      m = parse(filename, datafiles, includePaths, flag_ignoreStdlib, false, flag_verbose, errstream);
+      m = parse(filename, datafiles, includePaths, flag_ignoreStdlib, false, flag_verbose, errstream,
+                stdlib_cache_dir);
+    }
+    if (m==NULL) {
+      if (flag_verbose)
+        err << std::endl;
+      std::copy(istreambuf_iterator<char>(errstream),istreambuf_iterator<char>(),ostreambuf_iterator<char>(err));
+      return EXIT_FAILURE;
+    }
+    int status = compile(m, err, fzn, ozn, cstats, lasttime);
+    delete m;
+    if (status != EXIT_SUCCESS)
+      return status;
+  }
+
+  cstats.time = starttime.ms();
+  if (!flag_statistics_json.empty()) {
+    cstats.collectGC();
+    std::ofstream os(flag_statistics_json.c_str());
+    cstats.printJSON(os);
+    if (!os.good()) {
+      err << "I/O error: cannot write statistics file. " << strerror(errno) << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (flag_verbose) {
+    err << "Done (overall time " << stoptime(cstats.time) << ", ";
+    size_t mem = GC::maxMem();
+    if (mem < 1024)
+      err << "maximum memory " << mem << " bytes";
+    else if (mem < 1024*1024)
+      err << "maximum memory " << mem/1024 << " Kbytes";
+    else
+      err << "maximum memory " << mem/(1024*1024) << " Mbytes";
+    err << ")." << std::endl;
+    err << "Garbage collection: " << GC::collections() << " collections, "
+              << std::setprecision(0) << std::fixed << GC::pauseTime() << " ms total pause, "
+              << std::setprecision(1) << GC::maxPauseTime() << " ms maximum pause" << std::endl;
+    if (!GC::markTimes().empty()) {
+      err << "Mark phase (" << GC::markThreads() << " threads):";
+      for (unsigned int i=0; i<GC::markTimes().size(); i++)
+        err << (i==0 ? " " : ", ") << GC::markTimes()[i];
+      err << " ms" << std::endl;
     }
-    
-    if (m) {
-      try {
-        if (flag_typecheck) {
-          Env env(m);
+    err << "Interned strings: " << GC::internedStrings() << " ("
+              << GC::internedStringMem()/1024 << " Kbytes)" << std::endl;
+    err << "Interned literals: " << GC::intLits().size() << " int, "
+              << GC::floatLits().size() << " float, " << GC::intSets().size() << " set" << std::endl;
+    err << "Heap: " << GC::pages() << " pages, " << GC::largePages() << " large object pages ("
+              << GC::cachedLargePages() << " cached), "
+              << std::setprecision(1) << 100.0*GC::fragmentation() << "% on free lists" << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
+
+std::string
+Compilation::dependencyOptions(void) const {
+  std::ostringstream oss;
+  oss << flag_ignoreStdlib << flag_newfzn << flag_optimize << flag_no_output_ozn << flag_werror << "\n"
+      << flag_output_fzn << "\n" << flag_output_ozn << "\n";
+  if (flag_stdinInput)
+    oss << modelText;
+  return oss.str();
+}
+
+int
+Compilation::compile(Model* m, std::ostream& err, std::string* fzn, std::string* ozn,
+                     CompilerStatistics& cstats, Timer& lasttime) {
+  try {
+    if (flag_typecheck) {
+      Env env(m);
+      double ms = endphase(cstats, "parse", lasttime);
+      if (flag_verbose)
+        err << "Done parsing (" << stoptime(ms) << ")" << std::endl;
+      if (flag_verbose)
+        err << "Typechecking ...";
+      vector<TypeError> typeErrors;
+      MiniZinc::typecheck(env, m, typeErrors);
+      if (typeErrors.size() > 0) {
+        for (unsigned int i=0; i<typeErrors.size(); i++) {
           if (flag_verbose)
-            std::cerr << "Done parsing (" << stoptime(lasttime) << ")" << std::endl;
+            err << std::endl;
+          err << typeErrors[i].loc() << ":" << std::endl;
+          err << typeErrors[i].what() << ": " << typeErrors[i].msg() << std::endl;
+        }
+        return EXIT_FAILURE;
+      }
+      MiniZinc::registerBuiltins(env,m);
+      ms = endphase(cstats, "typecheck", lasttime);
+      if (flag_verbose)
+        err << " done (" << stoptime(ms) << ")" << std::endl;
+
+      Dependencies deps;
+      if (!flag_dependencies.empty() && !flag_instance_check_only) {
+        if (flag_verbose)
+          err << "Checking dependencies ...";
+        deps.compute(m, dependencyOptions());
+        Dependencies old;
+        bool reuse = false;
+        std::vector<std::string> changed;
+        if (old.read(flag_dependencies)) {
+          // The previous output can only be reused if it was written to the same files,
+          // and not if statistics or a profile of the flattening are requested
+          reuse = fzn==NULL && !flag_output_fzn_stdout && !flag_output_ozn_stdout &&
+            !flag_statistics && flag_statistics_json.empty() && !flag_profile &&
+            deps.unchanged(old) && old.outputsUnchanged();
+          if (!reuse)
+            changed = deps.changed(old);
+        }
+        ms = endphase(cstats, "dependencies", lasttime);
+        if (flag_verbose) {
+          err << " done (" << stoptime(ms);
+          if (reuse) {
+            err << ", reusing " << flag_output_fzn;
+          } else if (!changed.empty()) {
+            err << ", changed";
+            for (unsigned int i=0; i<changed.size() && i<5; i++)
+              err << (i==0 ? " " : ", ") << changed[i];
+            if (changed.size() > 5)
+              err << " and " << (changed.size()-5) << " more";
+          }
+          err << ")" << std::endl;
+        }
+        if (reuse)
+          return EXIT_SUCCESS;
+        // The previous output is about to be replaced
+        std::remove(flag_dependencies.c_str());
+      }
+
+      if (!flag_instance_check_only) {
+        if (flag_verbose)
+          err << "Flattening ...";
+        Profiler profiler;
+        if (flag_profile)
+          fopts.profiler = &profiler;
+        // Output that produced warnings is not recorded for reuse, so that
+        // the warnings are printed again
+        bool hadWarnings = false;
+        try {
+          flatten(env,fopts);
+        } catch (LocationException& e) {
           if (flag_verbose)
-            std::cerr << "Typechecking ...";
-          vector<TypeError> typeErrors;
-          MiniZinc::typecheck(env, m, typeErrors);
-          if (typeErrors.size() > 0) {
-            for (unsigned int i=0; i<typeErrors.size(); i++) {
-              if (flag_verbose)
-                std::cerr << std::endl;
-              std::cerr << typeErrors[i].loc() << ":" << std::endl;
-              std::cerr << typeErrors[i].what() << ": " << typeErrors[i].msg() << std::endl;
+            err << std::endl;
+          err << e.what() << ": " << std::endl;
+          env.dumpErrorStack(err);
+          err << "  " << e.msg() << std::endl;
+          return EXIT_FAILURE;
+        }
+        for (unsigned int i=0; i<env.warnings().size(); i++) {
+          err << (flag_werror ? "Error: " : "Warning: ") << env.warnings()[i];
+        }
+        if (flag_werror && env.warnings().size() > 0) {
+          return EXIT_FAILURE;
+        }
+        hadWarnings = env.warnings().size() > 0;
+        env.clearWarnings();
+        Model* flat = env.flat();
+        ms = endphase(cstats, "flatten", lasttime);
+        if (flag_verbose)
+          err << " done (" << stoptime(ms) << ", max stack depth " << env.maxCallStack()
+                    << ", " << env.cseHits() << "/" << env.cseLookups() << " CSE lookups hit, "
+                    << m->fnCacheHits() << "/" << (m->fnCacheHits()+m->fnCacheMisses())
+                    << " overloads resolved from cache)" << std::endl;
+        if (flag_profile) {
+          profiler.print(err, 20);
+          if (!flag_profile_json.empty()) {
+            std::ofstream os(flag_profile_json.c_str());
+            profiler.printJSON(os);
+            if (!os.good()) {
+              err << "I/O error: cannot write profile file. " << strerror(errno) << "." << std::endl;
+              return EXIT_FAILURE;
             }
-            exit(EXIT_FAILURE);
           }
-          MiniZinc::registerBuiltins(env,m);
+        }
+        
+        if (flag_optimize) {
           if (flag_verbose)
-            std::cerr << " done (" << stoptime(lasttime) << ")" << std::endl;
-
-          if (!flag_instance_check_only) {
-            if (flag_verbose)
-              std::cerr << "Flattening ...";
-            try {
-              flatten(env,fopts);
-            } catch (LocationException& e) {
-              if (flag_verbose)
-                std::cerr << std::endl;
-              std::cerr << e.what() << ": " << std::endl;
-              env.dumpErrorStack(std::cerr);
-              std::cerr << "  " << e.msg() << std::endl;
-              exit(EXIT_FAILURE);
-            }
-            for (unsigned int i=0; i<env.warnings().size(); i++) {
-              std::cerr << (flag_werror ? "Error: " : "Warning: ") << env.warnings()[i];
-            }
-            if (flag_werror && env.warnings().size() > 0) {
-              exit(EXIT_FAILURE);
-            }
-            env.clearWarnings();
-            Model* flat = env.flat();
-            if (flag_verbose)
-              std::cerr << " done (" << stoptime(lasttime) << ", max stack depth " << env.maxCallStack() << ")" << std::endl;
-            
-            if (flag_optimize) {
-              if (flag_verbose)
-                std::cerr << "Optimizing ...";
-              optimize(env);
-              for (unsigned int i=0; i<env.warnings().size(); i++) {
-                std::cerr << (flag_werror ? "Error: " : "Warning: ") << env.warnings()[i];
-              }
-              if (flag_werror && env.warnings().size() > 0) {
-                exit(EXIT_FAILURE);
-              }
-              if (flag_verbose)
-                std::cerr << " done (" << stoptime(lasttime) << ")" << std::endl;
-            }
-            
-            if (!flag_newfzn) {
-              if (flag_verbose)
-                std::cerr << "Converting to old FlatZinc ...";
-              oldflatzinc(env);
-              if (flag_verbose)
-                std::cerr << " done (" << stoptime(lasttime) << ")" << std::endl;
-            } else {
-              env.flat()->compact();
-              env.output()->compact();
-            }
-            
-            if (flag_statistics) {
-              FlatModelStatistics stats = statistics(env);
-              std::cerr << "Generated FlatZinc statistics:\n";
-              std::cerr << "Variables: ";
-              bool had_one = false;
-              if (stats.n_bool_vars) {
-                had_one = true;
-                std::cerr << stats.n_bool_vars << " bool";
-              }
-              if (stats.n_int_vars) {
-                if (had_one) std::cerr << ", ";
-                had_one = true;
-                std::cerr << stats.n_int_vars << " int";
-              }
-              if (stats.n_float_vars) {
-                if (had_one) std::cerr << ", ";
-                had_one = true;
-                std::cerr << stats.n_float_vars << " float";
-              }
-              if (stats.n_set_vars) {
-                if (had_one) std::cerr << ", ";
-                had_one = true;
-                std::cerr << stats.n_set_vars << " int";
-              }
-              if (!had_one)
-                std::cerr << "none";
-              std::cerr << "\n";
-              std::cerr << "Constraints: ";
-              had_one = false;
-              if (stats.n_bool_ct) {
-                had_one = true;
-                std::cerr << stats.n_bool_ct << " bool";
-              }
-              if (stats.n_int_ct) {
-                if (had_one) std::cerr << ", ";
-                had_one = true;
-                std::cerr << stats.n_int_ct << " int";
-              }
-              if (stats.n_float_ct) {
-                if (had_one) std::cerr << ", ";
-                had_one = true;
-                std::cerr << stats.n_float_ct << " float";
-              }
-              if (stats.n_set_ct) {
-                if (had_one) std::cerr << ", ";
-                had_one = true;
-                std::cerr << stats.n_set_ct << " int";
-              }
-              if (!had_one)
-                std::cerr << "none";
-              std::cerr << "\n";
-            }
-            
-            if (flag_verbose)
-              std::cerr << "Printing FlatZinc ...";
-            if (flag_output_fzn_stdout) {
-              Printer p(std::cout,0);
-              p.print(flat);
-            } else {
-              std::ofstream os;
-              os.open(flag_output_fzn.c_str(), ios::out);
-              if (!os.good()) {
-                if (flag_verbose)
-                  std::cerr << std::endl;
-                std::cerr << "I/O error: cannot open fzn output file. " << strerror(errno) << "." << std::endl;
-                exit(EXIT_FAILURE);
-              }
-              Printer p(os,0);
-              p.print(flat);
-              os.close();
-            }
-            if (flag_verbose)
-              std::cerr << " done (" << stoptime(lasttime) << ")" << std::endl;
-            if (!flag_no_output_ozn) {
-              if (flag_verbose)
-                std::cerr << "Printing .ozn ...";
-              if (flag_output_ozn_stdout) {
-                Printer p(std::cout,0);
-                p.print(env.output());
-              } else {
-                std::ofstream os;
-                os.open(flag_output_ozn.c_str(), ios::out);
-                if (!os.good()) {
-                  if (flag_verbose)
-                    std::cerr << std::endl;
-                  std::cerr << "I/O error: cannot open ozn output file. " << strerror(errno) << "." << std::endl;
-                  exit(EXIT_FAILURE);
-                }
-                Printer p(os,0);
-                p.print(env.output());
-                os.close();
-              }
-              if (flag_verbose)
-                std::cerr << " done (" << stoptime(lasttime) << ")" << std::endl;
-            }
+            err << "Optimizing ...";
+          optimize(env);
+          for (unsigned int i=0; i<env.warnings().size(); i++) {
+            err << (flag_werror ? "Error: " : "Warning: ") << env.warnings()[i];
           }
-        } else { // !flag_typecheck
-          Printer p(std::cout);
-          p.print(m);
+          if (flag_werror && env.warnings().size() > 0) {
+            return EXIT_FAILURE;
+          }
+          hadWarnings = hadWarnings || env.warnings().size() > 0;
+          ms = endphase(cstats, "optimize", lasttime);
+          if (flag_verbose)
+            err << " done (" << stoptime(ms) << ")" << std::endl;
         }
-      } catch (LocationException& e) {
-        if (flag_verbose)
-          std::cerr << std::endl;
-        std::cerr << e.loc() << ":" << std::endl;
-        std::cerr << e.what() << ": " << e.msg() << std::endl;
-        exit(EXIT_FAILURE);
-      } catch (Exception& e) {
+        
+        if (!flag_newfzn) {
+          if (flag_verbose)
+            err << "Converting to old FlatZinc ...";
+          oldflatzinc(env);
+          ms = endphase(cstats, "oldflatzinc", lasttime);
+          if (flag_verbose)
+            err << " done (" << stoptime(ms) << ")" << std::endl;
+        } else {
+          env.flat()->compact();
+          env.output()->compact();
+        }
+        
+        if (!flag_statistics_json.empty())
+          cstats.collect(env);
+        if (flag_statistics) {
+          FlatModelStatistics stats = statistics(env);
+          err << "Generated FlatZinc statistics:\n";
+          err << "Variables: ";
+          bool had_one = false;
+          if (stats.n_bool_vars) {
+            had_one = true;
+            err << stats.n_bool_vars << " bool";
+          }
+          if (stats.n_int_vars) {
+            if (had_one) err << ", ";
+            had_one = true;
+            err << stats.n_int_vars << " int";
+          }
+          if (stats.n_float_vars) {
+            if (had_one) err << ", ";
+            had_one = true;
+            err << stats.n_float_vars << " float";
+          }
+          if (stats.n_set_vars) {
+            if (had_one) err << ", ";
+            had_one = true;
+            err << stats.n_set_vars << " int";
+          }
+          if (!had_one)
+            err << "none";
+          err << "\n";
+          err << "Constraints: ";
+          had_one = false;
+          if (stats.n_bool_ct) {
+            had_one = true;
+            err << stats.n_bool_ct << " bool";
+          }
+          if (stats.n_int_ct) {
+            if (had_one) err << ", ";
+            had_one = true;
+            err << stats.n_int_ct << " int";
+          }
+          if (stats.n_float_ct) {
+            if (had_one) err << ", ";
+            had_one = true;
+            err << stats.n_float_ct << " float";
+          }
+          if (stats.n_set_ct) {
+            if (had_one) err << ", ";
+            had_one = true;
+            err << stats.n_set_ct << " int";
+          }
+          if (!had_one)
+            err << "none";
+          err << "\n";
+        }
+        
         if (flag_verbose)
-          std::cerr << std::endl;
-        std::cerr << e.what() << ": " << e.msg() << std::endl;
-        exit(EXIT_FAILURE);
+          err << "Printing FlatZinc ...";
+        if (!printModel(flat, "fzn", "print_fzn", fzn, flag_output_fzn_stdout, flag_output_fzn,
+                        err, cstats, lasttime))
+          return EXIT_FAILURE;
+        if (!flag_no_output_ozn) {
+          if (flag_verbose)
+            err << "Printing .ozn ...";
+          if (!printModel(env.output(), "ozn", "print_ozn", ozn, flag_output_ozn_stdout, flag_output_ozn,
+                          err, cstats, lasttime))
+            return EXIT_FAILURE;
+        }
+        if (!flag_dependencies.empty() && !hadWarnings) {
+          std::vector<std::string> files;
+          if (fzn==NULL && !flag_output_fzn_stdout) {
+            files.push_back(flag_output_fzn);
+            if (!flag_no_output_ozn && !flag_output_ozn_stdout)
+              files.push_back(flag_output_ozn);
+          }
+          deps.outputs(files);
+          if (!deps.write(flag_dependencies)) {
+            err << "I/O error: cannot write dependencies file. " << strerror(errno) << "." << std::endl;
+            return EXIT_FAILURE;
+          }
+        }
       }
-      delete m;
-    } else {
+    } else { // !flag_typecheck
+      if (fzn) {
+        std::ostringstream oss;
+        Printer p(oss);
+        p.print(m);
+        *fzn += oss.str();
+      } else {
+        Printer p(std::cout);
+        p.print(m);
+      }
+    }
+  } catch (LocationException& e) {
+    if (flag_verbose)
+      err << std::endl;
+    err << e.loc() << ":" << std::endl;
+    err << e.what() << ": " << e.msg() << std::endl;
+    return EXIT_FAILURE;
+  } catch (Exception& e) {
+    if (flag_verbose)
+      err << std::endl;
+    err << e.what() << ": " << e.msg() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+bool
+Compilation::printModel(Model* m, const char* kind, const char* phase, std::string* s,
+                        bool toStdout, const std::string& file,
+                        std::ostream& err, CompilerStatistics& cstats, Timer& lasttime) {
+  unsigned long long int bytes;
+  if (s) {
+    FdPrinter p(*s);
+    p.print(m);
+    p.flush();
+    bytes = p.bytesWritten();
+  } else {
+    int fd = toStdout ? openOutput("") : openOutput(file);
+    if (fd < 0) {
       if (flag_verbose)
-        std::cerr << std::endl;
-      std::copy(istreambuf_iterator<char>(errstream),istreambuf_iterator<char>(),ostreambuf_iterator<char>(std::cerr));
-      exit(EXIT_FAILURE);
+        err << std::endl;
+      err << "I/O error: cannot open " << kind << " output file. " << strerror(errno) << "." << std::endl;
+      return false;
     }
+    FdPrinter p(fd);
+    p.print(m);
+    if (!p.flush()) {
+      if (flag_verbose)
+        err << std::endl;
+      err << "I/O error: cannot write " << kind << " output file. " << strerror(errno) << "." << std::endl;
+      closeOutput(fd);
+      return false;
+    }
+    bytes = p.bytesWritten();
+    closeOutput(fd);
   }
+  double ms = endphase(cstats, phase, lasttime);
+  if (flag_verbose)
+    err << " done (" << throughput(ms, bytes) << ")" << std::endl;
+  return true;
+}
 
-  if (flag_verbose) {
-    std::cerr << "Done (overall time " << stoptime(starttime) << ", ";
-    size_t mem = GC::maxMem();
-    if (mem < 1024)
-      std::cerr << "maximum memory " << mem << " bytes";
-    else if (mem < 1024*1024)
-      std::cerr << "maximum memory " << mem/1024 << " Kbytes";
-    else
-      std::cerr << "maximum memory " << mem/(1024*1024) << " Mbytes";
-    std::cerr << ")." << std::endl;
-    
+/*
+ * Compile server
+ *
+ * With --server, mzn2fzn reads compile requests from standard input and
+ * writes the answers to standard output. With --server-socket, it accepts
+ * connections on a Unix domain socket instead, serving one connection at
+ * a time. A request is
+ *
+ *   compile <n> <len>\n<argument 1>\n...<argument n>\n<model text>
+ *
+ * where the arguments are mzn2fzn options and files, one per line, and
+ * the model text of <len> bytes is compiled instead of a model file if
+ * <len> is not zero. The answer is
+ *
+ *   ok <fzn length> <ozn length> <message length>\n<fzn><ozn><messages>
+ *
+ * or, if the compilation failed,
+ *
+ *   error <message length>\n<messages>
+ *
+ * where the messages are the warnings, errors and statistics that mzn2fzn
+ * would print to standard error. A request consisting of the line "quit"
+ * stops the server.
+ *
+ * Each request is compiled with the options given to the server followed
+ * by its own arguments. Parsed library files are kept in memory, so that
+ * they are read only once, and the heap is collected after each request.
+ */
+
+/// Buffered connection to a client of the compile server
+class Connection {
+protected:
+  /// File descriptor for reading requests
+  int _in;
+  /// File descriptor for writing answers
+  int _out;
+  /// Input buffer
+  char _buf[1<<16];
+  /// Position of the next byte in the buffer
+  size_t _pos;
+  /// End of the data in the buffer
+  size_t _end;
+  /// Refill the buffer, return false at the end of the input
+  bool fill(void) {
+    for (;;) {
+#ifdef _WIN32
+      int n = _read(_in, _buf, sizeof(_buf));
+#else
+      ssize_t n = ::read(_in, _buf, sizeof(_buf));
+#endif
+      if (n < 0 && errno==EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      _pos = 0;
+      _end = n;
+      return true;
+    }
+  }
+public:
+  Connection(int in, int out) : _in(in), _out(out), _pos(0), _end(0) {}
+  /// Read a line (without the newline) into \a s, return false at the end of the input
+  bool readLine(std::string& s) {
+    s.clear();
+    for (;;) {
+      if (_pos==_end && !fill())
+        return false;
+      const char* nl = static_cast<const char*>(memchr(_buf+_pos, '\n', _end-_pos));
+      if (nl) {
+        s.append(_buf+_pos, nl-(_buf+_pos));
+        _pos = nl-_buf+1;
+        return true;
+      }
+      s.append(_buf+_pos, _end-_pos);
+      _pos = _end;
+    }
+  }
+  /// Read \a n bytes into \a s, return false at the end of the input
+  bool readBytes(std::string& s, size_t n) {
+    s.clear();
+    while (s.size() < n) {
+      if (_pos==_end && !fill())
+        return false;
+      size_t k = std::min(n-s.size(), _end-_pos);
+      s.append(_buf+_pos, k);
+      _pos += k;
+    }
+    return true;
+  }
+  /// Write \a s, return false if an I/O error occurred
+  bool write(const std::string& s) {
+    size_t off = 0;
+    while (off < s.size()) {
+#ifdef _WIN32
+      int n = _write(_out, s.c_str()+off, static_cast<unsigned int>(s.size()-off));
+#else
+      ssize_t n = ::write(_out, s.c_str()+off, s.size()-off);
+#endif
+      if (n < 0) {
+        if (errno != EINTR)
+          return false;
+      } else {
+        off += n;
+      }
+    }
+    return true;
+  }
+};
+
+/// Answer the requests on \a c using options \a base, return false if the server should stop
+bool serve(const Compilation& base, Connection& c) {
+  std::string line;
+  while (c.readLine(line)) {
+    if (line=="quit")
+      return false;
+    std::istringstream iss(line);
+    std::string command;
+    unsigned int nargs;
+    size_t textlen;
+    if (!(iss >> command >> nargs >> textlen) || command != "compile") {
+      std::string msg = "Error: invalid request.\n";
+      std::ostringstream answer;
+      answer << "error " << msg.size() << "\n" << msg;
+      c.write(answer.str());
+      return true;
+    }
+    vector<string> args(nargs);
+    for (unsigned int i=0; i<nargs; i++) {
+      if (!c.readLine(args[i]))
+        return true;
+    }
+    Compilation comp(base);
+    if (!c.readBytes(comp.modelText, textlen))
+      return true;
+    comp.flag_server = false;
+    comp.flag_server_socket.clear();
+    std::ostringstream err;
+    std::string fzn;
+    std::string ozn;
+    int status = EXIT_FAILURE;
+    if (!comp.processArgs(args, err) || comp.flag_version || comp.flag_server ||
+        comp.flag_batch != "") {
+      err << "Error: invalid arguments." << std::endl;
+    } else if (textlen > 0 && (comp.filename != "" || comp.datafiles.size() > 0)) {
+      err << "Error: model text cannot be combined with model or data files." << std::endl;
+    } else if (textlen==0 && comp.filename=="" && !comp.flag_stdinInput) {
+      err << "Error: no model file given." << std::endl;
+    } else {
+      if (textlen > 0)
+        comp.flag_stdinInput = true;
+      status = comp.run(err, &fzn, &ozn);
+    }
+    GC::collect();
+    std::string msg = err.str();
+    std::ostringstream answer;
+    if (status==EXIT_SUCCESS) {
+      answer << "ok " << fzn.size() << " " << ozn.size() << " " << msg.size() << "\n";
+      if (!c.write(answer.str()) || !c.write(fzn) || !c.write(ozn) || !c.write(msg))
+        return true;
+    } else {
+      answer << "error " << msg.size() << "\n";
+      if (!c.write(answer.str()) || !c.write(msg))
+        return true;
+    }
+  }
+  return true;
+}
+
+#ifndef _WIN32
+/// Serve connections to the Unix domain socket \a path one at a time
+int serveSocket(const Compilation& base, const std::string& path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Error: socket path " << path << " is too long." << std::endl;
+    return EXIT_FAILURE;
+  }
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  int s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s < 0 || bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 16) != 0) {
+    std::cerr << "Error: cannot listen on socket " << path << ". " << strerror(errno) << "." << std::endl;
+    if (s >= 0)
+      close(s);
+    return EXIT_FAILURE;
+  }
+  int status = EXIT_SUCCESS;
+  bool running = true;
+  while (running) {
+    int fd = accept(s, NULL, NULL);
+    if (fd < 0) {
+      if (errno==EINTR)
+        continue;
+      std::cerr << "Error: cannot accept connection. " << strerror(errno) << "." << std::endl;
+      status = EXIT_FAILURE;
+      break;
+    }
+    Connection c(fd, fd);
+    running = serve(base, c);
+    close(fd);
+  }
+  close(s);
+  unlink(path.c_str());
+  return status;
+}
+#endif
+
+/// Run the compile server with options \a base
+int runServer(const Compilation& base) {
+  residentParseCache(true);
+  {
+    // Load the library before accepting requests, which also checks the options
+    Compilation comp(base);
+    comp.flag_stdinInput = true;
+    comp.modelText = "solve satisfy;\n";
+    std::ostringstream err;
+    std::string fzn;
+    std::string ozn;
+    if (comp.run(err, &fzn, &ozn) != EXIT_SUCCESS) {
+      std::cerr << err.str();
+      return EXIT_FAILURE;
+    }
+    GC::collect();
+  }
+#ifdef _WIN32
+  if (!base.flag_server_socket.empty()) {
+    std::cerr << "Error: --server-socket is not supported on this platform." << std::endl;
+    return EXIT_FAILURE;
+  }
+  _setmode(0, _O_BINARY);
+  _setmode(1, _O_BINARY);
+#else
+  signal(SIGPIPE, SIG_IGN);
+  if (!base.flag_server_socket.empty())
+    return serveSocket(base, base.flag_server_socket);
+#endif
+  Connection c(0, 1);
+  serve(base, c);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Batch compilation
+ *
+ * With --batch <file>, mzn2fzn compiles the model against each instance
+ * listed in <file>. Each line lists the data files of one instance,
+ * separated by white space. The output for an instance is written to the
+ * .fzn and .ozn files named after its first data file, and a summary of
+ * the compile times is printed to standard output at the end.
+ *
+ * The model and the library are parsed only once and then kept in memory,
+ * but each instance is typechecked and flattened in a fresh Env, since
+ * the typechecked model depends on the data. With --jobs <n>, the
+ * instances are divided among n worker processes.
+ */
+
+/// Result of compiling an instance in batch mode
+struct BatchResult {
+  /// Exit status of the compilation (-1 if unknown)
+  int status;
+  /// Compile time (in milliseconds)
+  double ms;
+  BatchResult(void) : status(-1), ms(0.0) {}
+};
+
+/// Compile the model of \a base against the data files \a inst
+BatchResult compileInstance(const Compilation& base, const vector<string>& inst) {
+  Compilation comp(base);
+  comp.datafiles.insert(comp.datafiles.end(), inst.begin(), inst.end());
+  comp.flag_output_base = inst[0].substr(0,inst[0].length()-4);
+  std::ostringstream err;
+  Timer timer;
+  BatchResult r;
+  r.status = comp.run(err);
+  r.ms = timer.ms();
+  GC::collect();
+  if (!err.str().empty()) {
+    // Print the messages of an instance in one piece, as workers share standard error
+    std::ostringstream oss;
+    oss << "Instance " << inst[0] << ":" << std::endl << err.str();
+    std::cerr << oss.str();
+    std::cerr.flush();
+  }
+  return r;
+}
+
+/// Compile the model of \a base against each instance in the batch file
+int runBatch(const Compilation& base) {
+  vector<vector<string> > instances;
+  {
+    std::ifstream is(base.flag_batch.c_str());
+    if (!is.is_open()) {
+      std::cerr << "Error: cannot open batch file '" << base.flag_batch << "'." << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::string line;
+    while (std::getline(is, line)) {
+      std::istringstream iss(line);
+      vector<string> inst;
+      std::string datafile;
+      while (iss >> datafile) {
+        if (datafile.length()<=4 ||
+            datafile.substr(datafile.length()-4,string::npos) != ".dzn") {
+          std::cerr << "Error: batch file entry " << datafile << " is not a .dzn file." << std::endl;
+          return EXIT_FAILURE;
+        }
+        inst.push_back(datafile);
+      }
+      if (!inst.empty())
+        instances.push_back(inst);
+    }
+  }
+
+  Timer timer;
+  residentParseCache(true);
+  residentMainModel(true);
+  {
+    // Parse the model and the library before compiling the instances
+    Compilation comp(base);
+    comp.flag_typecheck = false;
+    std::ostringstream err;
+    std::string fzn;
+    std::string ozn;
+    if (comp.run(err, &fzn, &ozn) != EXIT_SUCCESS) {
+      std::cerr << err.str();
+      return EXIT_FAILURE;
+    }
+    GC::collect();
+  }
+
+  vector<BatchResult> results(instances.size());
+  unsigned int jobs = std::max(1u, std::min(static_cast<unsigned int>(base.flag_jobs),
+                                            static_cast<unsigned int>(instances.size())));
+#ifdef _WIN32
+  jobs = 1;
+#else
+  if (jobs > 1) {
+    // Each worker compiles every jobs-th instance and reports the results
+    // as lines "<instance> <status> <ms>" on a pipe
+    vector<int> fds;
+    vector<pid_t> pids;
+    std::cout.flush();
+    for (unsigned int k=0; k<jobs; k++) {
+      int p[2];
+      if (pipe(p) != 0) {
+        std::cerr << "Error: cannot start worker. " << strerror(errno) << "." << std::endl;
+        break;
+      }
+      pid_t pid = fork();
+      if (pid==0) {
+        for (unsigned int j=0; j<fds.size(); j++)
+          close(fds[j]);
+        close(p[0]);
+        Connection c(p[1], p[1]);
+        for (unsigned int i=k; i<instances.size(); i+=jobs) {
+          BatchResult r = compileInstance(base, instances[i]);
+          std::ostringstream oss;
+          oss << i << " " << r.status << " " << r.ms << "\n";
+          c.write(oss.str());
+        }
+        _exit(EXIT_SUCCESS);
+      }
+      close(p[1]);
+      if (pid < 0) {
+        std::cerr << "Error: cannot start worker. " << strerror(errno) << "." << std::endl;
+        close(p[0]);
+        break;
+      }
+      fds.push_back(p[0]);
+      pids.push_back(pid);
+    }
+    // Instances of workers that could not be started remain without result
+    for (unsigned int k=0; k<fds.size(); k++) {
+      Connection c(fds[k], fds[k]);
+      std::string line;
+      while (c.readLine(line)) {
+        std::istringstream iss(line);
+        unsigned int i;
+        BatchResult r;
+        if (iss >> i >> r.status >> r.ms && i < results.size())
+          results[i] = r;
+      }
+      close(fds[k]);
+    }
+    for (unsigned int k=0; k<pids.size(); k++)
+      waitpid(pids[k], NULL, 0);
+  } else
+#endif
+  {
+    for (unsigned int i=0; i<instances.size(); i++)
+      results[i] = compileInstance(base, instances[i]);
+  }
+
+  unsigned int failed = 0;
+  std::cout << "Batch summary:" << std::endl;
+  for (unsigned int i=0; i<instances.size(); i++) {
+    if (results[i].status != EXIT_SUCCESS)
+      failed++;
+    std::cout << std::setw(10) << std::setprecision(1) << std::fixed << results[i].ms << " ms  "
+              << (results[i].status==EXIT_SUCCESS ? "ok    " : "failed");
+    for (unsigned int j=0; j<instances[i].size(); j++)
+      std::cout << "  " << instances[i][j];
+    std::cout << std::endl;
   }
-  return 0;
+  std::cout << instances.size() << " instances, " << failed << " failed, " << jobs << " jobs, "
+            << "overall time " << stoptime(timer.ms()) << std::endl;
+  return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-error:
-  std::cerr << "Usage: "<< argv[0]
+void usage(const char* prog) {
+  std::cerr << "Usage: "<< prog
             << " [<options>] [-I <include path>] <model>.mzn [<data>.dzn ...]" << std::endl
             << std::endl
             << "Options:" << std::endl
@@ -537,11 +1245,13 @@ error:
             << "  --ignore-stdlib\n    Ignore the standard libraries stdlib.mzn and builtins.mzn" << std::endl
             << "  -v, --verbose\n    Print progress statements" << std::endl
             << "  -s, --statistics\n    Print statistics" << std::endl
+            << "  --statistics-json <file>\n    Write phase times, flat model, CSE and garbage collector statistics to <file> as JSON" << std::endl
             << "  --instance-check-only\n    Check the model instance (including data) for errors, but do not\n    convert to FlatZinc." << std::endl
             << "  --no-optimize\n    Do not optimize the FlatZinc\n    Currently does nothing (only available for compatibility with 1.6)" << std::endl
             << "  -d <file>, --data <file>\n    File named <file> contains data used by the model." << std::endl
             << "  -D <data>, --cmdline-data <data>\n    Include the given data in the model." << std::endl
             << "  --stdlib-dir <dir>\n    Path to MiniZinc standard library directory" << std::endl
+            << "  --stdlib-cache <dir>\n    Cache parsed library files in <dir> (also set by the\n    MZN_STDLIB_CACHE environment variable)" << std::endl
             << "  -G --globals-dir --mzn-globals-dir\n    Search for included files in <stdlib>/<dir>." << std::endl
             << std::endl
             << "Input/Output options:" << std::endl
@@ -552,8 +1262,65 @@ error:
             << "  --output-ozn-to-file <file>\n    Filename for model output specification" << std::endl
             << "  --output-to-stdout, --output-fzn-to-stdout\n    Print generated FlatZinc to standard output" << std::endl
             << "  --output-ozn-to-stdout\n    Print model output specification to standard output" << std::endl
+            << "  --dependencies <file>\n    Cache the output files: record the hashes of the sources, data and\n    options in <file>, and keep the existing output instead of flattening\n    if none of them changed" << std::endl
             << "  -Werror\n    Turn warnings into errors" << std::endl
+            << "  --gc-incremental\n    Sweep the heap incrementally during allocation instead of\n    in a single pause after each garbage collection" << std::endl
+            << "  --profile\n    Print the cost of flattening each source line and predicate" << std::endl
+            << "  --profile-json <file>\n    Also write the flattening profile to <file> as JSON" << std::endl
+            << "  --gc-mark-threads <n>\n    Use <n> threads to mark the heap during garbage collection" << std::endl
+            << std::endl
+            << "Server options:" << std::endl
+            << "  --server\n    Keep the library loaded and compile the models requested on standard input" << std::endl
+            << "  --server-socket <path>\n    Like --server, but accept requests on the Unix domain socket <path>" << std::endl
+            << std::endl
+            << "Batch options:" << std::endl
+            << "  --batch <file>\n    Compile the model for each line of data files in <file>, and print a summary" << std::endl
+            << "  --jobs <n>\n    Compile the instances of a batch in <n> worker processes" << std::endl
   ;
+}
 
-  exit(EXIT_FAILURE);
+
+int main(int argc, char** argv) {
+  Compilation c;
+  vector<string> args(argv+1, argv+argc);
+  if (args.empty() || !c.processArgs(args, std::cerr)) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (c.flag_version) {
+    std::cout << "NICTA MiniZinc to FlatZinc converter, version "
+      << MZN_VERSION_MAJOR << "." << MZN_VERSION_MINOR << "." << MZN_VERSION_PATCH << std::endl;
+    std::cout << "Copyright (C) 2014, 2015 Monash University and NICTA" << std::endl;
+    std::exit(EXIT_SUCCESS);
+  }
+  if (c.flag_server) {
+    if (c.filename != "" || c.datafiles.size() > 0 || c.flag_stdinInput) {
+      std::cerr << "Error: no model or data can be given to the server." << std::endl;
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    return runServer(c);
+  }
+  if (c.flag_batch != "") {
+    if (c.filename=="" || c.flag_stdinInput) {
+      std::cerr << "Error: no model file given." << std::endl;
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    if (c.flag_output_base != "" || c.flag_output_fzn != "" || c.flag_output_ozn != "" ||
+        c.flag_output_fzn_stdout || c.flag_output_ozn_stdout) {
+      std::cerr << "Error: output files are named after the data files in batch mode." << std::endl;
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    return runBatch(c);
+  }
+  if (c.filename=="" && !c.flag_stdinInput) {
+    std::cerr << "Error: no model file given." << std::endl;
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (c.flag_stdinInput)
+    c.modelText = std::string(istreambuf_iterator<char>(std::cin), istreambuf_iterator<char>());
+  return c.run(std::cerr);
 }
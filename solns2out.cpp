@@ -27,6 +27,7 @@
 #include <minizinc/builtins.hh>
 #include <minizinc/file_utils.hh>
 #include <minizinc/timer.hh>
+#include <minizinc/dzn_reader.hh>
 
 using namespace MiniZinc;
 using namespace std;
@@ -37,6 +38,57 @@ std::string stoptime(Timer& timer) {
   return oss.str();
 }
 
+typedef UNORDERED_NAMESPACE::unordered_map<std::string,VarDecl*> SolutionDecls;
+
+/// Check if literal \a e can be assigned to a variable of type \a t
+bool literalMatches(Expression* e, const Type& t) {
+  if (ArrayLit* al = e->dyn_cast<ArrayLit>()) {
+    if (t.dim() != al->dims())
+      return false;
+    for (unsigned int i=0; i<al->v().size(); i++) {
+      if (al->v()[i]->type().bt() != t.bt() || al->v()[i]->type().st() != t.st())
+        return false;
+    }
+    return true;
+  }
+  return t.dim()==0 && e->type().bt()==t.bt() && e->type().st()==t.st();
+}
+
+/**
+ * \brief Read \a solution if it only consists of literal assignments
+ *
+ * Returns the assigned declarations and values in \a assignments, and a
+ * normalised copy of the solution text (without comments) in \a key.
+ * Returns false if anything else is found, in which case the solution
+ * has to be read by the parser.
+ */
+bool readSolution(const std::string& solution, const SolutionDecls& decls, std::string& key,
+                  std::vector<pair<VarDecl*,Expression*> >& assignments) {
+  DznReader r(solution.c_str(), solution.c_str()+solution.size());
+  std::string id;
+  while (!r.done()) {
+    if (!r.readAssignmentId(id))
+      return false;
+    SolutionDecls::const_iterator it = decls.find(id);
+    if (it==decls.end())
+      return false;
+    VarDecl* vd = it->second;
+    const char* rhs = r.pos();
+    Expression* e = r.readLiteral();
+    if (e==NULL || !literalMatches(e, vd->type()))
+      return false;
+    key += id;
+    key += '=';
+    key.append(rhs, r.pos());
+    key += ';';
+    if (!r.readAssignmentEnd())
+      return false;
+    e->type(vd->type());
+    assignments.push_back(pair<VarDecl*,Expression*>(vd,e));
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   Timer starttime;
   string filename;
@@ -175,14 +227,25 @@ int main(int argc, char** argv) {
         
         typedef pair<VarDecl*,Expression*> DE;
         ASTStringMap<DE>::t declmap;
+        SolutionDecls solutionDecls;
+        // Declarations with a right hand side, and their original values
+        std::vector<pair<VarDecl*,KeepAlive> > derived;
         Expression* outputExpr = NULL;
         for (unsigned int i=0; i<outputm->size(); i++) {
           if (VarDeclI* vdi = (*outputm)[i]->dyn_cast<VarDeclI>()) {
             declmap.insert(pair<ASTString,DE>(vdi->e()->id()->v(),DE(vdi->e(),vdi->e()->e())));
+            solutionDecls.insert(pair<std::string,VarDecl*>(vdi->e()->id()->str().str(),vdi->e()));
+            if (vdi->e()->e())
+              derived.push_back(pair<VarDecl*,KeepAlive>(vdi->e(),vdi->e()->e()));
           } else if (OutputI* oi = (*outputm)[i]->dyn_cast<OutputI>()) {
             outputExpr = oi->e();
           }
         }
+        // Declarations assigned by the previous solution
+        std::vector<VarDecl*> assigned;
+        // Assignments of the previous solution, and the resulting output
+        std::string lastKey;
+        std::string lastOutput;
 
         //ostream& fout(flag_output_file.empty() ? std::cout : new fstream(flag_output_file));
         fstream file_ostream;
@@ -211,53 +274,67 @@ int main(int argc, char** argv) {
               if (solutions_found > 1 && !solution_comma.empty())
                 fout << solution_comma << std::endl;
               if (outputExpr != NULL) {
-                for (unsigned int i=0; i<outputm->size(); i++) {
-                  if (VarDeclI* vdi = (*outputm)[i]->dyn_cast<VarDeclI>()) {
-                    ASTStringMap<DE>::t::iterator it = declmap.find(vdi->e()->id()->v());
-                    vdi->e()->e(it->second.second);
-                    vdi->e()->evaluated(false);
+                GCLock lock;
+                std::string key;
+                std::vector<DE> assignments;
+                bool literal = readSolution(solution, solutionDecls, key, assignments);
+                // Only re-evaluate output when the solution has changed
+                if (!literal || key != lastKey) {
+                  for (unsigned int i=0; i<assigned.size(); i++) {
+                    assigned[i]->e(NULL);
+                    assigned[i]->evaluated(false);
                   }
-                }
-                Model* sm = parseFromString(solution, "solution.szn", includePaths, true, false, false, cerr);
-                for (unsigned int i=0; i<sm->size(); i++) {
-                  if (AssignI* ai = (*sm)[i]->dyn_cast<AssignI>()) {
-                    ASTStringMap<DE>::t::iterator it = declmap.find(ai->id());
-                    if (it==declmap.end()) {
-                      cerr << "Error: unexpected identifier " << ai->id() << " in output\n";
-                      exit(EXIT_FAILURE);
+                  assigned.clear();
+                  for (unsigned int i=0; i<derived.size(); i++) {
+                    derived[i].first->e(derived[i].second());
+                    derived[i].first->evaluated(false);
+                  }
+                  if (literal) {
+                    for (unsigned int i=0; i<assignments.size(); i++) {
+                      assignments[i].first->e(assignments[i].second);
+                      assigned.push_back(assignments[i].first);
                     }
-                    ai->e()->type(it->second.first->type());
-                    ai->decl(it->second.first);
-                    typecheck(env,outputm, ai);
-                    if (Call* c = ai->e()->dyn_cast<Call>()) {
-                      // This is an arrayXd call, make sure we get the right builtin
-                      assert(c->args()[c->args().size()-1]->isa<ArrayLit>());
-                      for (unsigned int i=0; i<c->args().size(); i++)
-                        c->args()[i]->type(Type::parsetint());
-                      c->args()[c->args().size()-1]->type(it->second.first->type());
-                      c->decl(outputm->matchFn(env.envi(),c));
+                  } else {
+                    Model* sm = parseFromString(solution, "solution.szn", includePaths, true, false, false, cerr);
+                    if (sm==NULL)
+                      exit(EXIT_FAILURE);
+                    for (unsigned int i=0; i<sm->size(); i++) {
+                      if (AssignI* ai = (*sm)[i]->dyn_cast<AssignI>()) {
+                        ASTStringMap<DE>::t::iterator it = declmap.find(ai->id());
+                        if (it==declmap.end()) {
+                          cerr << "Error: unexpected identifier " << ai->id() << " in output\n";
+                          exit(EXIT_FAILURE);
+                        }
+                        ai->e()->type(it->second.first->type());
+                        ai->decl(it->second.first);
+                        typecheck(env,outputm, ai);
+                        if (Call* c = ai->e()->dyn_cast<Call>()) {
+                          // This is an arrayXd call, make sure we get the right builtin
+                          assert(c->args()[c->args().size()-1]->isa<ArrayLit>());
+                          for (unsigned int i=0; i<c->args().size(); i++)
+                            c->args()[i]->type(Type::parsetint());
+                          c->args()[c->args().size()-1]->type(it->second.first->type());
+                          c->decl(outputm->matchFn(env.envi(),c));
+                        }
+                        it->second.first->e(ai->e());
+                        assigned.push_back(it->second.first);
+                      }
                     }
-                    it->second.first->e(ai->e());
+                    delete sm;
                   }
-                }
-                delete sm;
-                
-                GCLock lock;
-                ArrayLit* al = eval_array_lit(env.envi(),outputExpr);
-                std::string os;
-                for (unsigned int i=0; i<al->v().size(); i++) {
-                  std::string s = eval_string(env.envi(),al->v()[i]);
-                  if (!s.empty()) {
-                    os = s;
-                    fout << os;
-                    if (flag_output_flush)
-                      fout.flush();
+
+                  ArrayLit* al = eval_array_lit(env.envi(),outputExpr);
+                  lastOutput.clear();
+                  for (unsigned int i=0; i<al->v().size(); i++) {
+                    lastOutput += eval_string(env.envi(),al->v()[i]);
                   }
+                  lastKey = literal ? key : std::string();
                 }
-                if (!os.empty() && os[os.size()-1] != '\n')
+                fout << lastOutput;
+                if (!lastOutput.empty() && lastOutput[lastOutput.size()-1] != '\n')
                   fout << std::endl;
-                  if (flag_output_flush)
-                    fout.flush();
+                if (flag_output_flush)
+                  fout.flush();
               }
               fout << comments;
               fout << solution_separator << std::endl;